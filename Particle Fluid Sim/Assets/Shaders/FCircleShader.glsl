@@ -1,18 +1,39 @@
 #version 330 core
 
-in vec3 pos;
+in vec3 viewPos;
 in vec4 finalColor;
+flat in vec3 viewCenter;
+
+uniform float u_Scale;
+
+layout (std140) uniform Camera
+{
+	mat4 u_View;
+	mat4 u_Projection;
+};
+
+const vec3 LightDirection = vec3(0.36, 0.48, 0.8);  // in view space
+const float Ambient = 0.35;
 
 out vec4 fragCol;
 
 void main()
 {
-	float dist2 = dot(pos.xy, pos.xy);  // the distance of the current pixel from the quad's middle
-	float threshold = 0.25;
-
-	if (dist2 < threshold) {
-		fragCol = finalColor;
-	} else {
+	// the eye ray through the pixel, the eye sits at the origin of view space
+	vec3 ray = normalize(viewPos);
+	float radius = 0.5 * u_Scale;
+	float along = dot(ray, viewCenter);  // the distance along the ray to the point closest to the centre
+	float h = along * along - dot(viewCenter, viewCenter) + radius * radius;
+	if (h < 0.0) {
 		discard;
 	}
+
+	// the nearest point where the ray enters the sphere
+	vec3 hit = (along - sqrt(h)) * ray;
+	vec3 normal = (hit - viewCenter) / radius;
+	vec4 clipPos = u_Projection * vec4(hit, 1.0);
+	gl_FragDepth = 0.5 * (gl_DepthRange.diff * (clipPos.z / clipPos.w) + gl_DepthRange.near + gl_DepthRange.far);
+
+	float diffuse = max(dot(normal, LightDirection), 0.0);
+	fragCol = vec4(finalColor.rgb * (Ambient + (1.0 - Ambient) * diffuse), finalColor.a);
 }
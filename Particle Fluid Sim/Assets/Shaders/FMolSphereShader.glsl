@@ -1,9 +1,15 @@
 #version 330 core
 
 in vec4 finalColor;
+in vec3 viewNormal;
 out vec4 fragCol;
 
+// the same light as the impostors, so the levels of detail match
+const vec3 LightDirection = vec3(0.36, 0.48, 0.8);  // in view space
+const float Ambient = 0.35;
+
 void main()
 {
-	fragCol = finalColor;
+	float diffuse = max(dot(normalize(viewNormal), LightDirection), 0.0);
+	fragCol = vec4(finalColor.rgb * (Ambient + (1.0 - Ambient) * diffuse), finalColor.a);
 }
@@ -2,22 +2,39 @@
 
 layout (location = 0) in vec3 a_Pos;
 layout (location = 1) in vec3 a_Normal;
+layout (location = 2) in vec3 a_Position;  // of the molecule
+layout (location = 3) in float a_Speed;    // a fraction of the maximum speed
 
-uniform mat4 u_Model;
-uniform mat4 u_View;
-uniform mat4 u_Projection;
+uniform float u_Scale;  // the diameter of the molecules
 
-uniform float u_SpeedSq;
+// shared by all the shaders, Application updates it once per frame
+layout (std140) uniform Camera
+{
+	mat4 u_View;
+	mat4 u_Projection;
+};
+
+const float MaxSpeed = 12.0;  // Mesh::MaxInstanceSpeed
 
-out vec3 pos;
+out vec3 viewPos;  // the point of the quad in view space, the fragment shader casts the eye ray through it
 out vec4 finalColor;
+flat out vec3 viewCenter;  // the centre of the sphere in view space
 
 void main()
 {
-	gl_Position = u_Projection * u_View * u_Model * vec4(a_Pos, 1.0);
-
-	// pass the vertex position in local space for circle rendering
-	pos = a_Pos;
+	// the quad faces the eye and goes through the centre of the molecule, it is grown to the cone that touches
+	// the sphere, so the whole silhouette fits in it under the perspective projection
+	viewCenter = (u_View * vec4(a_Position, 1.0)).xyz;
+	float radius = 0.5 * u_Scale;
+	float distance2 = dot(viewCenter, viewCenter);
+	float halfSize = radius * sqrt(distance2 / max(distance2 - radius * radius, 1e-6));
+	vec3 forward = viewCenter / sqrt(max(distance2, 1e-12));
+	vec3 right = normalize(cross(forward, abs(forward.y) < 0.99 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0)));
+	vec3 up = cross(right, forward);
+	viewPos = viewCenter + 2.0 * halfSize * (a_Pos.x * right + a_Pos.y * up);
+	gl_Position = u_Projection * vec4(viewPos, 1.0);
+	float speed = a_Speed * MaxSpeed;
+	float speedSq = speed * speed;
 
 	vec4 color[4];
 	float thresholds[4];
@@ -30,16 +47,16 @@ void main()
 	thresholds[2] = 36.0;
 	thresholds[3] = 81.0;
 	finalColor = color[0];
-	if (u_SpeedSq > thresholds[3]) {
+	if (speedSq > thresholds[3]) {
 		finalColor = color[3];
 	}
-	else if (u_SpeedSq > thresholds[2]) {
-		finalColor = mix(color[2], color[3], (u_SpeedSq - thresholds[2]) / (thresholds[3] - thresholds[2]));
+	else if (speedSq > thresholds[2]) {
+		finalColor = mix(color[2], color[3], (speedSq - thresholds[2]) / (thresholds[3] - thresholds[2]));
 	}
-	else if (u_SpeedSq > thresholds[1]) {
-		finalColor = mix(color[1], color[2], (u_SpeedSq - thresholds[1]) / (thresholds[2] - thresholds[1]));
+	else if (speedSq > thresholds[1]) {
+		finalColor = mix(color[1], color[2], (speedSq - thresholds[1]) / (thresholds[2] - thresholds[1]));
 	}
-	else if (u_SpeedSq > thresholds[0]) {
-		finalColor = mix(color[0], color[1], (u_SpeedSq - thresholds[0]) / (thresholds[1] - thresholds[0]));
+	else if (speedSq > thresholds[0]) {
+		finalColor = mix(color[0], color[1], (speedSq - thresholds[0]) / (thresholds[1] - thresholds[0]));
 	}
 }
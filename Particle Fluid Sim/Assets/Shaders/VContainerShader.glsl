@@ -4,8 +4,13 @@ layout (location = 0) in vec3 a_Pos;
 layout (location = 1) in vec3 a_Normal;
 
 uniform mat4 u_Model;
-uniform mat4 u_View;
-uniform mat4 u_Projection;
+
+// shared by all the shaders, Application updates it once per frame
+layout (std140) uniform Camera
+{
+	mat4 u_View;
+	mat4 u_Projection;
+};
 
 void main()
 {
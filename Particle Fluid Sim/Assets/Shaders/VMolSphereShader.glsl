@@ -2,18 +2,31 @@
 
 layout (location = 0) in vec3 a_Pos;
 layout (location = 1) in vec3 a_Normal;
+layout (location = 2) in vec3 a_Position;  // of the molecule
+layout (location = 3) in float a_Speed;    // a fraction of the maximum speed
 
-uniform mat4 u_Model;
-uniform mat4 u_View;
-uniform mat4 u_Projection;
+uniform mat4 u_Model;  // the scale shared by all the molecules
 
-uniform float u_SpeedSq;
+// shared by all the shaders, Application updates it once per frame
+layout (std140) uniform Camera
+{
+	mat4 u_View;
+	mat4 u_Projection;
+};
+
+const float MaxSpeed = 12.0;  // Mesh::MaxInstanceSpeed
 
 out vec4 finalColor;
+out vec3 viewNormal;
 
 void main()
 {
-	gl_Position = u_Projection * u_View * u_Model * vec4(a_Pos, 1.0);
+	mat4 model = u_Model;
+	model[3].xyz += a_Position;
+	gl_Position = u_Projection * u_View * model * vec4(a_Pos, 1.0);
+	viewNormal = mat3(u_View) * a_Normal;  // the molecules are only scaled, the same in every direction
+	float speed = a_Speed * MaxSpeed;
+	float speedSq = speed * speed;
 
 	vec4 color[4];
 	float thresholds[4];
@@ -26,16 +39,16 @@ void main()
 	thresholds[2] = 36.0;
 	thresholds[3] = 81.0;
 	finalColor = color[0];
-	if (u_SpeedSq > thresholds[3]) {
+	if (speedSq > thresholds[3]) {
 		finalColor = color[3];
 	}
-	else if (u_SpeedSq > thresholds[2]) {
-		finalColor = mix(color[2], color[3], (u_SpeedSq - thresholds[2]) / (thresholds[3] - thresholds[2]));
+	else if (speedSq > thresholds[2]) {
+		finalColor = mix(color[2], color[3], (speedSq - thresholds[2]) / (thresholds[3] - thresholds[2]));
 	}
-	else if (u_SpeedSq > thresholds[1]) {
-		finalColor = mix(color[1], color[2], (u_SpeedSq - thresholds[1]) / (thresholds[2] - thresholds[1]));
+	else if (speedSq > thresholds[1]) {
+		finalColor = mix(color[1], color[2], (speedSq - thresholds[1]) / (thresholds[2] - thresholds[1]));
 	}
-	else if (u_SpeedSq > thresholds[0]) {
-		finalColor = mix(color[0], color[1], (u_SpeedSq - thresholds[0]) / (thresholds[1] - thresholds[0]));
+	else if (speedSq > thresholds[0]) {
+		finalColor = mix(color[0], color[1], (speedSq - thresholds[0]) / (thresholds[1] - thresholds[0]));
 	}
 }
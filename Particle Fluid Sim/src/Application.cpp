@@ -8,6 +8,10 @@
 #include "Renderer.h"
 #include "Random.h"
 #include "SPHSolver.h"
+#include "CollisionSolver.h"
+#include "StepScheduler.h"
+#include "Profiler.h"
+#include "Tracer.h"
 
 // returns an error code as a c-style out parameter
 Application::Application(const std::string& name, bool* success)
@@ -45,12 +49,16 @@ Application::Application(const std::string& name, bool* success)
 		*success = false;
 	}
 
+	// the trace always records, the rings of the solver workers are allocated when its pool starts
+	Tracer::SetEnabled(true);
+	Tracer::RegisterThread("Main thread");
+
 	Random::Init();
 	Renderer::UI::Init(&m_Window);
-	Renderer::Scene::Init();
-	SPHSolver::Init();
 
 	m_ClearColor[0] = m_ClearColor[1] = m_ClearColor[2] = 0.1f;
+	// the molecules overlap, the impostors write the depth of the sphere under each pixel
+	glEnable(GL_DEPTH_TEST);
 
 	std::string vShaderPath = "..\\Particle Fluid Sim\\Assets\\Shaders\\VMolSphereShader.glsl";
 	std::string fShaderPath = "..\\Particle Fluid Sim\\Assets\\Shaders\\FMolSphereShader.glsl";
@@ -60,10 +68,20 @@ Application::Application(const std::string& name, bool* success)
 	fShaderPath = "..\\Particle Fluid Sim\\Assets\\Shaders\\FContainerShader.glsl";
 	m_ContainerShader = std::make_shared<Shader>(vShaderPath, fShaderPath);
 
-	m_MoleculeShader->SetUniformMatrix4f("u_Projection", m_Cam.GetProjection());
-	m_MoleculeShader->SetUniformMatrix4f("u_View", m_Cam.GetView());
-	m_ContainerShader->SetUniformMatrix4f("u_Projection", m_Cam.GetProjection());
-	m_ContainerShader->SetUniformMatrix4f("u_View", m_Cam.GetView());
+	vShaderPath = "..\\Particle Fluid Sim\\Assets\\Shaders\\VCircleShader.glsl";
+	fShaderPath = "..\\Particle Fluid Sim\\Assets\\Shaders\\FCircleShader.glsl";
+	m_ImpostorShader = std::make_shared<Shader>(vShaderPath, fShaderPath);
+
+	// the camera matrices live in one uniform block that both shaders read
+	m_CameraBuffer = std::make_shared<UniformBuffer>(2 * sizeof(glm::mat4), Application::CameraBinding);
+	m_MoleculeShader->BindUniformBlock("Camera", *m_CameraBuffer);
+	m_ContainerShader->BindUniformBlock("Camera", *m_CameraBuffer);
+	m_ImpostorShader->BindUniformBlock("Camera", *m_CameraBuffer);
+	const glm::mat4 camera[2] = { m_Cam.GetView(), m_Cam.GetProjection() };
+	m_CameraBuffer->SetData(camera, sizeof(camera));
+
+	Renderer::Scene::Init(m_ContainerShader, m_MoleculeShader, m_ImpostorShader);
+	SPHSolver::Init(Renderer::Scene::GetSimulationConfig());
 
 }
 
@@ -80,20 +98,43 @@ void Application::Run()
 {
 	// the render loop
 	while (!glfwWindowShouldClose(m_Window)) {
-		BeginFrame();
-		UpdateFrame();
-		DrawFrame();
-		EndFrame();
+		TraceScope trace("Frame");
+		{
+			TraceScope scope("BeginFrame");
+			BeginFrame();
+		}
+		{
+			TraceScope scope("UpdateFrame");
+			UpdateFrame();
+		}
+		{
+			TraceScope scope("DrawFrame");
+			DrawFrame();
+		}
+		{
+			TraceScope scope("EndFrame");
+			EndFrame();
+		}
+	}
+
+	if (m_DumpTraceOnExit) {
+		Tracer::Dump(m_TraceFile);
 	}
 }
 
+void Application::SetTraceFile(const std::string& path, bool dumpOnExit)
+{
+	m_TraceFile = path;
+	m_DumpTraceOnExit = dumpOnExit;
+}
+
 void Application::BeginFrame()
 {
 	Renderer::UI::BeginFrame();
 
 	// clear the frame
 	glClearColor(m_ClearColor[0], m_ClearColor[1], m_ClearColor[2], 1.0f);
-	glClear(GL_COLOR_BUFFER_BIT);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 }
 
 // updates the logic
@@ -111,6 +152,12 @@ void Application::UpdateFrame()
 	if (glfwGetKey(m_Window, GLFW_KEY_C) == GLFW_PRESS) {
 		Renderer::UI::ShowWindowType(Renderer::UI::WindowTypes::CONTROLS);
 	}
+	// the solver workers are parked between frames, so the rings can be read here
+	const bool traceKey = glfwGetKey(m_Window, GLFW_KEY_F9) == GLFW_PRESS;
+	if (traceKey && !m_TraceKeyDown) {
+		Tracer::Dump(m_TraceFile);
+	}
+	m_TraceKeyDown = traceKey;
 
 	m_Cam.Update(Renderer::UI::GetDeltaTime(), m_Window);
 
@@ -118,22 +165,35 @@ void Application::UpdateFrame()
 
 	// update the properties of all molecules
 	if (!m_Paused) {
-		uint32_t numIters = 7;
-		for (uint32_t i = 0; i < numIters; i++) {
-			SPHSolver::Update(Renderer::UI::GetDeltaTime() / numIters, Renderer::Scene::GetContainerBounds());
-		}
+		// the solver only sees the UI through the config and the container state
+		SPHSolver::SimulationConfig config = Renderer::Scene::GetSimulationConfig();
+		CollisionSolver::ContainerState container = CollisionSolver::MakeContainerState(
+			Renderer::Scene::GetContainerTransform(), Renderer::Scene::GetContainerRotation());
+		// the solver always advances by the fixed step, as many times as the frame time requires
+		StepScheduler::SetTimeStep(Renderer::Scene::GetDeltaTime());
+		StepScheduler::SetBudget(Renderer::Scene::GetStepBudget());
+		StepScheduler::Advance(Renderer::UI::GetDeltaTime(), [&config, &container](float dt) {
+			SPHSolver::Update(dt, config, container);
+		});
 	}
 
-	m_MoleculeShader->SetUniformMatrix4f("u_View", m_Cam.GetView());
-	m_ContainerShader->SetUniformMatrix4f("u_View", m_Cam.GetView());
+	const glm::mat4 view = m_Cam.GetView();
+	m_CameraBuffer->SetData(&view, sizeof(view));
+	Renderer::Scene::SetCamera(view, m_Cam.GetProjection(), (float)Application::Height);
 
 }
 
 // draws the frame based on the new logic
 void Application::DrawFrame()
 {
-	Renderer::Scene::Render(m_ContainerShader, m_MoleculeShader, m_Paused);
-	Renderer::UI::Draw();
+	{
+		ProfileScope scope(Profiler::Section::RENDER);
+		Renderer::Scene::Render(m_ContainerShader, m_MoleculeShader, m_ImpostorShader, m_Paused);
+	}
+	{
+		ProfileScope scope(Profiler::Section::UI);
+		Renderer::UI::Draw();
+	}
 }
 
 // ends the frame
@@ -141,4 +201,5 @@ void Application::EndFrame()
 {
 	glfwSwapBuffers(m_Window);
 	glfwPollEvents();
+	Profiler::EndFrame();
 }
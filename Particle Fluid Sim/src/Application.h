@@ -19,11 +19,15 @@ public:
 	// the render loop
 	void Run();
 
+	// where F9 writes the trace of the last frames, optionally also once the window closes
+	void SetTraceFile(const std::string& path, bool dumpOnExit);
+
 public:
 	// window attributes
 	static constexpr uint16_t Width  = 1600;
 	static constexpr uint16_t Height = 900;
 	static constexpr float AspectRatio = 1.777777777f;
+	static constexpr GLuint CameraBinding = 0;  // the binding point of the camera uniform block
 
 private:
 	// basic render loop methods, called in Application::Run()
@@ -39,8 +43,14 @@ private:
 
 	Ref<Shader> m_MoleculeShader;
 	Ref<Shader> m_ContainerShader;
+	Ref<Shader> m_ImpostorShader;
+	Ref<UniformBuffer> m_CameraBuffer;
 
 	bool m_Paused = true;
 	glm::vec3 m_ClearColor;
 
+	std::string m_TraceFile = "trace.json";
+	bool m_DumpTraceOnExit = false;
+	bool m_TraceKeyDown = false;  // the trace is written once per key press, not every frame it is held
+
 };
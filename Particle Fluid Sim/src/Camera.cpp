@@ -3,6 +3,8 @@
 #include <glew/glew.h>
 #include <glfw/glfw3.h>
 
+#include <algorithm>
+
 static constexpr float pi = 3.1415926f;
 static constexpr float tau = 6.2831853f;
 
@@ -11,7 +13,7 @@ Camera::Camera(float aspectRatio)
 	theta(pi / 2.0f),
 	phi(pi / 2.0f)
 {
-	m_Position = glm::vec3(0.0f, 0.0f, 50.0f);
+	m_Position = glm::vec3(0.0f, 0.0f, m_Radius);
 	m_View = glm::lookAt(m_Position, glm::vec3(0.0f), Camera::Up);
 	m_Projection = glm::perspective(glm::radians(45.0f), aspectRatio, 0.1f, 100.0f);
 }
@@ -33,10 +35,18 @@ void Camera::Update(float dt, GLFWwindow* pwnd)
 	theta = std::fmod(theta, tau);
 	phi = std::fmod(phi, pi);
 
-	const float radius = 50.0f;
-	m_Position.x = radius * std::cosf(theta) * std::sinf(phi);
-	m_Position.z = radius * std::sinf(theta) * std::sinf(phi);
-	m_Position.y = radius * std::cosf(phi);
+	// zooming moves the camera along the orbit's radius, it stays inside the far plane
+	if (glfwGetKey(pwnd, GLFW_KEY_R) == GLFW_PRESS) {
+		m_Radius -= 20.0f * dt;
+	}
+	if (glfwGetKey(pwnd, GLFW_KEY_F) == GLFW_PRESS) {
+		m_Radius += 20.0f * dt;
+	}
+	m_Radius = std::clamp(m_Radius, 5.0f, 90.0f);
+
+	m_Position.x = m_Radius * std::cosf(theta) * std::sinf(phi);
+	m_Position.z = m_Radius * std::sinf(theta) * std::sinf(phi);
+	m_Position.y = m_Radius * std::cosf(phi);
 	m_View = glm::lookAt(m_Position, glm::vec3(0.0f), Camera::Up);
 }
 
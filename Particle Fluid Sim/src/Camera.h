@@ -25,6 +25,7 @@ private:
 	glm::mat4 m_Projection;
 
 	glm::vec3 m_Position;
+	float m_Radius = 50.0f;  // of the orbit around the origin
 
 	float theta;
 	float phi;
@@ -1,13 +0,0 @@
-#pragma once
-
-#include "SPHSolver.h"
-
-class CollisionSolver
-{
-public:
-	static void ContainerCollision(SPHSolver::MoleculeProperties& props, float moleculeScale);
-
-private:
-	CollisionSolver() = default;
-
-};
\ No newline at end of file
@@ -3,6 +3,9 @@
 #include <glew/glew.h>
 #include <glfw/glfw3.h>
 
+#include <glm/gtc/packing.hpp>
+
+#include <algorithm>
 #include <iostream>
 
 static constexpr float pi = 3.1415926f;
@@ -17,6 +20,14 @@ Mesh::Mesh(const glm::vec3& translation, const glm::vec3& scale)
 Mesh::~Mesh()
 {
 	// frees the allocated resources
+	for (GLsync fence : m_Fences) {
+		if (fence != nullptr) {
+			glDeleteSync(fence);
+		}
+	}
+	if (m_InstanceVBO != 0) {
+		glDeleteBuffers(1, &m_InstanceVBO);
+	}
 	glDeleteBuffers(1, &m_EBO);
 	glDeleteBuffers(1, &m_VBO);
 	glDeleteVertexArrays(1, &m_VAO);
@@ -32,6 +43,11 @@ const std::vector<GLuint>& Mesh::GetIndices()
 	return m_Indices;
 }
 
+size_t Mesh::GetVertexCount()
+{
+	return m_Vertices.size();
+}
+
 void Mesh::SetTranslation(const glm::vec3& translation)
 {
 	m_Props.Translation = translation;
@@ -87,6 +103,112 @@ void Mesh::SetupMesh()
 	glBindVertexArray(0);
 }
 
+Mesh::InstanceData Mesh::PackInstance(const glm::vec3& position, float speed)
+{
+	Mesh::InstanceData instance;
+	instance.Position[0] = glm::packHalf1x16(position.x);
+	instance.Position[1] = glm::packHalf1x16(position.y);
+	instance.Position[2] = glm::packHalf1x16(position.z);
+	instance.Speed = (uint8_t)(std::min(speed / Mesh::MaxInstanceSpeed, 1.0f) * 255.0f + 0.5f);
+	instance.Padding = 0;
+	return instance;
+}
+
+void Mesh::SetupInstances(size_t maxInstances)
+{
+	m_SlotBytes = maxInstances * sizeof(Mesh::InstanceData);
+	const GLsizeiptr ringBytes = (GLsizeiptr)(m_SlotBytes * Mesh::StreamSlots);
+
+	glGenBuffers(1, &m_InstanceVBO);
+	glBindVertexArray(m_VAO);
+	glBindBuffer(GL_ARRAY_BUFFER, m_InstanceVBO);
+
+	// with buffer storage the ring stays mapped for its whole life
+	// otherwise every slot gets mapped when it is written
+	if (GLEW_ARB_buffer_storage && glBufferStorage != nullptr) {
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_ARRAY_BUFFER, ringBytes, nullptr, flags);
+		m_PersistentData = (uint8_t*)glMapBufferRange(GL_ARRAY_BUFFER, 0, ringBytes, flags);
+	}
+	else {
+		glBufferData(GL_ARRAY_BUFFER, ringBytes, nullptr, GL_STREAM_DRAW);
+	}
+
+	// both attributes advance once per instance instead of once per vertex
+	// they are pointed at the slot of the frame when it is drawn
+	glEnableVertexAttribArray(2);
+	glVertexAttribDivisor(2, 1);
+	glEnableVertexAttribArray(3);
+	glVertexAttribDivisor(3, 1);
+
+	glBindVertexArray(0);
+}
+
+Mesh::InstanceData* Mesh::MapInstances(size_t count)
+{
+	// the slot was drawn StreamSlots frames ago, its fence tells when the GPU is done reading it
+	GLsync& fence = m_Fences[m_Slot];
+	if (fence != nullptr) {
+		// a timeout only means the GPU is still reading, the commands are flushed by the first wait
+		GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+		GLenum status = GL_TIMEOUT_EXPIRED;
+		while (status == GL_TIMEOUT_EXPIRED) {
+			status = glClientWaitSync(fence, flags, 1'000'000'000);
+			flags = 0;
+		}
+		if (status == GL_WAIT_FAILED) {
+			std::cout << "Error Mesh::MapInstances: waiting for the fence of slot " << m_Slot << " failed" << std::endl;
+		}
+		glDeleteSync(fence);
+		fence = nullptr;
+	}
+
+	const size_t offset = m_Slot * m_SlotBytes;
+	if (m_PersistentData != nullptr) {
+		m_SlotMapped = true;
+		return (Mesh::InstanceData*)(m_PersistentData + offset);
+	}
+	// the fence already keeps the GPU off the slot, so the driver does not have to
+	glBindBuffer(GL_ARRAY_BUFFER, m_InstanceVBO);
+	void* data = glMapBufferRange(GL_ARRAY_BUFFER, (GLintptr)offset, (GLsizeiptr)(count * sizeof(Mesh::InstanceData)),
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	if (data == nullptr) {
+		std::cout << "Error Mesh::MapInstances: could not map slot " << m_Slot << std::endl;
+	}
+	m_SlotMapped = data != nullptr;
+	return (Mesh::InstanceData*)data;
+}
+
+void Mesh::DrawInstances(size_t count)
+{
+	// a slot that could not be mapped holds nothing to draw and stays free for the next frame
+	if (!m_SlotMapped) {
+		std::cout << "Error Mesh::DrawInstances: slot " << m_Slot << " is not mapped" << std::endl;
+		return;
+	}
+	m_SlotMapped = false;
+
+	const size_t offset = m_Slot * m_SlotBytes;
+	glBindVertexArray(m_VAO);
+	glBindBuffer(GL_ARRAY_BUFFER, m_InstanceVBO);
+	if (m_PersistentData == nullptr) {
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+	}
+	glVertexAttribPointer(2, 3, GL_HALF_FLOAT, GL_FALSE, sizeof(Mesh::InstanceData), (void*)(offset + offsetof(Mesh::InstanceData, Position)));
+	glVertexAttribPointer(3, 1, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Mesh::InstanceData), (void*)(offset + offsetof(Mesh::InstanceData, Speed)));
+	if (count > 0) {
+		glDrawElementsInstanced(GL_TRIANGLES, (GLsizei)m_Indices.size(), GL_UNSIGNED_INT, nullptr, (GLsizei)count);
+	}
+
+	m_Fences[m_Slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	m_Slot = (m_Slot + 1) % Mesh::StreamSlots;
+}
+
+bool Mesh::IsPersistentlyMapped() const
+{
+	return m_PersistentData != nullptr;
+}
+
 Quad::Quad(const glm::vec3& translation, const glm::vec3& scale)
 	:
 	Mesh(translation, scale)
@@ -18,6 +18,7 @@ public:
 
 	GLuint GetVAO();
 	const std::vector<GLuint>& GetIndices();
+	size_t GetVertexCount();
 	const glm::mat4 GetTransform();
 	void SetTranslation(const glm::vec3& translation);
 	void SetRotation(float angle);
@@ -27,8 +28,27 @@ public:
 	// so for each position there are multiple vertices
 	virtual void AddVertices(const std::vector<glm::vec3>& positions) {}
 
+	// the per-instance attributes, a half float position at location 2 and the speed at location 3
+	struct InstanceData
+	{
+		uint16_t Position[3];
+		uint8_t Speed;  // a fraction of MaxInstanceSpeed, read as a normalised float
+		uint8_t Padding;
+	};
+	static Mesh::InstanceData PackInstance(const glm::vec3& position, float speed);
+
+	// the instances are streamed through a ring of frame slots, a slot is written while the GPU reads the others
+	void SetupInstances(size_t maxInstances);
+	// waits until the GPU is done with the next slot and returns its memory, nullptr if it could not be mapped
+	Mesh::InstanceData* MapInstances(size_t count);
+	// draws the instances written to the mapped slot and fences it, even when there are none; does nothing if the slot is not mapped
+	void DrawInstances(size_t count);
+	bool IsPersistentlyMapped() const;
+
 public:
 	static constexpr size_t MaxQuadsPerBatch = 100'000;
+	static constexpr uint32_t StreamSlots = 3;
+	static constexpr float MaxInstanceSpeed = 12.0f;  // faster instances get the colour of this speed
 
 protected:
 	// the characteristics of the mesh as a body
@@ -58,6 +78,12 @@ protected:
 
 protected:
 	GLuint m_VAO, m_VBO, m_EBO;
+	GLuint m_InstanceVBO = 0;
+	GLsync m_Fences[StreamSlots] = {};
+	uint8_t* m_PersistentData = nullptr;  // the whole ring, when buffer storage is available
+	size_t m_SlotBytes = 0;
+	uint32_t m_Slot = 0;
+	bool m_SlotMapped = false;  // only a mapped slot is unmapped, drawn and fenced
 
 };
 
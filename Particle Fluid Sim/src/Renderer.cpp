@@ -5,21 +5,44 @@
 
 #include "Random.h"
 #include "SPHSolver.h"
+#include "SolverKernels.h"
+#include "StepScheduler.h"
+#include "Profiler.h"
 
+#include <algorithm>
+#include <cfloat>
 #include <iostream>
 
+// the smallest radius on screen, in pixels, of a molecule drawn at each sphere level, smaller ones use the impostor
+static constexpr float LevelRadii[Renderer::Scene::NumLevels - 1] = { 24.0f, 10.0f, 4.0f };
+
 static struct ImGuiData
 {
 	ImGuiIO io;
 	bool Demo;
 	bool Telemetry;
 	bool Controls;
+	float PoolUtilisation = 0.0f;
+	float BarrierIdle = 0.0f;
+	float UtilisationTimer = 0.0f;
+	bool GridStatistics = false;
 } UIdata;
 
 static struct SceneData
 {
 	Ref<Cube> Container;
 	Ref<Sphere> MoleculeMesh;  // only one instance of the mesh needed
+	Ref<Quad> ImpostorMesh;    // a quad per molecule, the shader draws the sphere into it
+	Ref<Mesh> Levels[Renderer::Scene::NumLevels];  // the full sphere, two coarser ones and the impostor
+	uint32_t LevelCounts[Renderer::Scene::NumLevels] = {};  // of the last rendered frame
+	glm::mat4 View = glm::mat4(1.0f);
+	float PixelScale = 1.0f;  // turns a radius over the view depth into pixels
+	UniformHandle<glm::mat4> ContainerModel;
+	UniformHandle<glm::mat4> MoleculeModel;
+	UniformHandle<float> ImpostorScale;
+	uint32_t DrawCalls = 0;  // of the last rendered frame
+	size_t MoleculeVertices = 0;  // of the last rendered frame
+	size_t UploadBytes = 0;  // of the last rendered frame
 
 	glm::vec3 ContainerPosition = glm::vec3(0.0f, 0.0f, 0.0f);
 	float ContainerRotation = 0.0f;
@@ -29,7 +52,16 @@ static struct SceneData
 	float MoleculeScale = 0.515f;
 	float InfluenceRadius = 0.5f;
 	float Viscosity = 1.0f;
-	float Delta = 0.001666f;
+	float Delta = 0.001666f;  // the fixed time step of the solver
+	float StepBudget = 12.0f;  // the wall time the solver steps may take per frame, in milliseconds
+	int SortMethod = (int)SPHSolver::SortMethod::COUNTING;
+	int CellIndexing = (int)SPHSolver::CellIndexing::DENSE;
+	bool NeighbourLists = false;
+	float SkinDistance = 0.1f;
+	bool SymmetricPairs = false;
+	int GrainSize = 0;  // 0 lets the pool size the chunks
+	int Partition = (int)SPHSolver::WorkPartition::COST;
+	int Geometry = (int)Renderer::Scene::Geometry::IMPOSTOR;
 } Sdata;
 
 void Renderer::UI::Init(GLFWwindow** window)
@@ -76,7 +108,8 @@ void Renderer::UI::UpdateFrame(bool* paused)
 	ImGui::SetCursorPos({ cursor.x + 93.0f, cursor.y });
 	if (ImGui::SmallButton("Reset")) {
 		*paused = true;
-		SPHSolver::ResetMolecules();
+		SPHSolver::ResetMolecules(Renderer::Scene::GetSimulationConfig());
+		StepScheduler::Reset();
 	}
 	ImGui::End();
 
@@ -91,6 +124,15 @@ void Renderer::UI::UpdateFrame(bool* paused)
 		ImGui::SliderFloat("Influence Radius", &Sdata.InfluenceRadius, 0.1f, 2.0f);
 		ImGui::SliderFloat("Viscosity", &Sdata.Viscosity, 0.0f, 10.0f);
 		ImGui::SliderFloat("Delta Time", &Sdata.Delta, 0.0001f, 0.002f);
+		ImGui::SliderFloat("Step Budget (ms)", &Sdata.StepBudget, 1.0f, 50.0f);
+		ImGui::Combo("Neighbour Sort", &Sdata.SortMethod, "Comparison sort\0Counting sort\0Incremental sort\0");
+		ImGui::Combo("Cell Indexing", &Sdata.CellIndexing, "Spatial hash\0Dense grid\0Dense grid (Z order)\0");
+		ImGui::Checkbox("Neighbour Lists", &Sdata.NeighbourLists);
+		ImGui::SliderFloat("Skin Distance", &Sdata.SkinDistance, 0.0f, 0.5f);
+		ImGui::Checkbox("Symmetric Pairs", &Sdata.SymmetricPairs);
+		ImGui::SliderInt("Grain Size", &Sdata.GrainSize, 0, 4096);
+		ImGui::Combo("Work Partition", &Sdata.Partition, "Chunks\0Neighbour cost\0");
+		ImGui::Combo("Molecule Geometry", &Sdata.Geometry, "Sphere mesh\0Sphere impostors\0Level of detail\0");
 		ImGui::End();
 
 		Sdata.MoleculeMesh->SetScale(glm::vec3(Sdata.MoleculeScale));
@@ -123,21 +165,144 @@ void Renderer::UI::ShowWindowType(Renderer::UI::WindowTypes type)
 
 void Renderer::UI::TelemetryWindow(bool* popen)
 {
+	// the pool utilisation is averaged over half a second so the value stays readable
+	UIdata.UtilisationTimer += UIdata.io.DeltaTime;
+	if (UIdata.UtilisationTimer > 0.5f) {
+		UIdata.UtilisationTimer = 0.0f;
+		UIdata.PoolUtilisation = SPHSolver::SamplePoolUtilisation();
+		UIdata.BarrierIdle = SPHSolver::SampleBarrierIdle();
+	}
+
 	ImGui::Begin("Scene Telemetry", popen);
 	ImGui::Text("Application FPS: %.2f (%.2f ms / frame)", UIdata.io.Framerate, 1000.0f / UIdata.io.Framerate);
-	ImGui::Text("Number of Quads: %lu", Renderer::Scene::NumMolecules + 1);
+	ImGui::Text("Number of Quads: %u", Renderer::Scene::NumMolecules + 1);
 	ImGui::Text("Container Quads: 1");
-	ImGui::Text("Number of molecules: %lu (%lu draw calls)", Renderer::Scene::NumMolecules, Renderer::Scene::NumMolecules);
+	ImGui::Text("Number of molecules: %u (%u draw calls)", Renderer::Scene::NumMolecules, Renderer::Scene::GetDrawCalls());
+	ImGui::Text("Molecule vertices: %zu / frame", Renderer::Scene::GetMoleculeVertices());
+	if (Sdata.Geometry == (int)Renderer::Scene::Geometry::LOD) {
+		const uint32_t* levels = Renderer::Scene::GetLevelCounts();
+		ImGui::Text("Levels of detail: %u / %u / %u spheres, %u impostors", levels[0], levels[1], levels[2], levels[3]);
+	}
+	ImGui::Text("Instance upload: %.1f KB / frame (%s)", Renderer::Scene::GetUploadBytes() / 1024.0f,
+		Renderer::Scene::IsUploadPersistent() ? "persistent mapping" : "unsynchronised mapping");
+	ImGui::Text("Solver threads: %u (%.1f%% utilisation)", SPHSolver::GetNumThreads(), 100.0f * UIdata.PoolUtilisation);
+	ImGui::Text("Barrier idle: %.1f%% of the worker time in the passes", 100.0f * UIdata.BarrierIdle);
+	ImGui::Text("Solver kernels: %s", SolverKernels::GetISAName());
+	const StepScheduler::Statistics& steps = StepScheduler::GetStatistics();
+	ImGui::Text("Solver steps: %u / frame (%.2f ms / step)", steps.Steps, steps.StepMilliseconds);
+	ImGui::Text("Dropped sim time: %.1f ms last frame, %.2f s total", 1000.0f * steps.DroppedLastFrame, steps.DroppedTotal);
+
+	if (Sdata.SortMethod == (int)SPHSolver::SortMethod::INCREMENTAL) {
+		ImGui::Text("Re-sort: %.2f%% of the molecules changed cell", 100.0f * SPHSolver::GetChangedFraction());
+	}
+	if (Sdata.NeighbourLists) {
+		ImGui::Text("Neighbour lists: %llu rebuilds, %.1f entries / molecule", (unsigned long long)SPHSolver::GetListRebuilds(), SPHSolver::GetAverageListLength());
+	}
+	if (ImGui::Checkbox("Grid statistics", &UIdata.GridStatistics)) {
+		SPHSolver::SetCollectStatistics(UIdata.GridStatistics);
+	}
+	if (UIdata.GridStatistics) {
+		const SPHSolver::GridStatistics& stats = SPHSolver::GetGridStatistics();
+		if (stats.DenseGrid) {
+			ImGui::Text("Indexing: dense grid %d x %d (%u slots)", stats.GridSize.x, stats.GridSize.y, stats.TableSize);
+		}
+		else {
+			ImGui::Text("Indexing: spatial hash (%u slots)", stats.TableSize);
+		}
+		ImGui::Text("Occupied buckets: %u, colliding: %u", stats.OccupiedBuckets, stats.CollidingBuckets);
+		float falseRatio = stats.Candidates > 0 ? (float)stats.FalseCandidates / stats.Candidates : 0.0f;
+		ImGui::Text("Neighbour candidates: %llu, false: %llu (%.1f%%)", (unsigned long long)stats.Candidates, (unsigned long long)stats.FalseCandidates, 100.0f * falseRatio);
+	}
+	if (ImGui::CollapsingHeader("Frame breakdown", ImGuiTreeNodeFlags_DefaultOpen)) {
+		Renderer::UI::FrameBreakdown();
+	}
 	ImGui::End();
 }
 
+void Renderer::UI::FrameBreakdown()
+{
+	constexpr uint32_t numSections = (uint32_t)Profiler::Section::COUNT;
+	// one colour per section, the last one is the part of the frame no section covers
+	static const ImU32 colours[numSections + 1] = {
+		IM_COL32(230, 159, 0, 255), IM_COL32(86, 180, 233, 255), IM_COL32(0, 158, 115, 255),
+		IM_COL32(240, 228, 66, 255), IM_COL32(0, 114, 178, 255), IM_COL32(140, 110, 220, 255),
+		IM_COL32(213, 94, 0, 255), IM_COL32(204, 121, 167, 255), IM_COL32(150, 150, 150, 255),
+		IM_COL32(120, 200, 80, 255), IM_COL32(200, 80, 80, 255), IM_COL32(70, 70, 70, 255)
+	};
+
+	// the times are those of the main thread, the GPU runs asynchronously so render is the time to submit the draw calls
+	if (ImGui::BeginTable("Sections", 5, ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV | ImGuiTableFlags_SizingFixedFit)) {
+		ImGui::TableSetupColumn("Section (ms)");
+		ImGui::TableSetupColumn("Last");
+		ImGui::TableSetupColumn("Min");
+		ImGui::TableSetupColumn("Avg");
+		ImGui::TableSetupColumn("P99");
+		ImGui::TableHeadersRow();
+		auto row = [](const char* name, ImU32 colour, const Profiler::Statistics& stats) {
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			ImGui::TextColored(ImGui::ColorConvertU32ToFloat4(colour), "%s", name);
+			ImGui::TableNextColumn(); ImGui::Text("%.3f", stats.Last);
+			ImGui::TableNextColumn(); ImGui::Text("%.3f", stats.Min);
+			ImGui::TableNextColumn(); ImGui::Text("%.3f", stats.Average);
+			ImGui::TableNextColumn(); ImGui::Text("%.3f", stats.P99);
+		};
+		for (uint32_t s = 0; s < numSections; s++) {
+			row(Profiler::GetName((Profiler::Section)s), colours[s], Profiler::GetStatistics((Profiler::Section)s));
+		}
+		row("Frame", IM_COL32_WHITE, Profiler::GetFrameStatistics());
+		ImGui::EndTable();
+	}
+
+	// a stacked bar per frame, scaled to the p99 frame so a single spike does not flatten the graph
+	const uint32_t frames = Profiler::GetFrameCount();
+	const float width = ImGui::GetContentRegionAvail().x;
+	const float height = 120.0f;
+	const ImVec2 origin = ImGui::GetCursorScreenPos();
+	ImGui::Dummy(ImVec2(width, height));
+	ImDrawList* drawList = ImGui::GetWindowDrawList();
+	drawList->AddRectFilled(origin, ImVec2(origin.x + width, origin.y + height), IM_COL32(20, 20, 20, 255));
+	if (frames == 0) {
+		return;
+	}
+
+	const float scale = height / std::max(1.5f * Profiler::GetFrameStatistics().P99, 0.001f);
+	const float barWidth = width / Profiler::HistoryLength;
+	for (uint32_t f = 0; f < frames; f++) {
+		const float left = origin.x + f * barWidth;
+		const float right = left + std::max(barWidth - 1.0f, 1.0f);
+		float bottom = origin.y + height;
+		float covered = 0.0f;
+		for (uint32_t s = 0; s <= numSections; s++) {
+			float ms;
+			if (s < numSections) {
+				ms = Profiler::GetHistory((Profiler::Section)s, f);
+				covered += ms;
+			}
+			else {
+				ms = std::max(Profiler::GetFrameHistory(f) - covered, 0.0f);
+			}
+			const float top = std::max(bottom - ms * scale, origin.y);
+			if (top < bottom) {
+				drawList->AddRectFilled(ImVec2(left, top), ImVec2(right, bottom), colours[s]);
+			}
+			bottom = top;
+		}
+	}
+	ImGui::TextColored(ImGui::ColorConvertU32ToFloat4(colours[numSections]), "Other: frame time outside the sections (swap, events, waiting)");
+}
+
 float Renderer::UI::GetDeltaTime()
 {
 	return UIdata.io.DeltaTime;
 }
 
-void Renderer::Scene::Init()
+void Renderer::Scene::Init(Ref<Shader>& containerShader, Ref<Shader>& moleculeShader, Ref<Shader>& impostorShader)
 {
+	Sdata.ContainerModel = containerShader->GetUniform<glm::mat4>("u_Model");
+	Sdata.MoleculeModel = moleculeShader->GetUniform<glm::mat4>("u_Model");
+	Sdata.ImpostorScale = impostorShader->GetUniform<float>("u_Scale");
+
 	Sdata.Container = std::make_shared<Cube>();
 	Sdata.MoleculeMesh = std::make_shared<Sphere>(16, 16);
 	Sdata.Container->SetScale(glm::vec3(Sdata.ContainerScale.x, Sdata.ContainerScale.y, 1.0f));
@@ -145,39 +310,132 @@ void Renderer::Scene::Init()
 
 	Sdata.MoleculeMesh->SetScale(glm::vec3(Sdata.MoleculeScale));
 	Sdata.MoleculeMesh->SetRotation(0.0f);
+	Sdata.ImpostorMesh = std::make_shared<Quad>();
+
+	Sdata.Levels[0] = Sdata.MoleculeMesh;
+	Sdata.Levels[1] = std::make_shared<Sphere>(10, 10);
+	Sdata.Levels[2] = std::make_shared<Sphere>(6, 6);
+	Sdata.Levels[3] = Sdata.ImpostorMesh;
+	for (Ref<Mesh>& level : Sdata.Levels) {
+		level->SetupInstances(Renderer::Scene::NumMolecules);
+	}
+}
+
+void Renderer::Scene::SetCamera(const glm::mat4& view, const glm::mat4& projection, float viewportHeight)
+{
+	Sdata.View = view;
+	Sdata.PixelScale = 0.5f * projection[1][1] * viewportHeight;
 }
 
-void Renderer::Scene::Render(Ref<Shader>& containerShader, Ref<Shader>& moleculeShader, bool paused)
+void Renderer::Scene::Render(Ref<Shader>& containerShader, Ref<Shader>& moleculeShader, Ref<Shader>& impostorShader, bool paused)
 {
 	containerShader->Use();
 	Sdata.Container->SetTranslation(Sdata.ContainerPosition);
 	Sdata.Container->SetRotation(Sdata.ContainerRotation);
 	Sdata.Container->SetScale(Sdata.ContainerScale);
-	containerShader->SetUniformMatrix4f("u_Model", Sdata.Container->GetTransform());
+	containerShader->SetUniform(Sdata.ContainerModel, Sdata.Container->GetTransform());
 	glBindVertexArray(Sdata.Container->GetVAO());
 	glDrawElements(GL_LINE_LOOP, (GLsizei)Sdata.Container->GetIndices().size(), GL_UNSIGNED_INT, nullptr);
+	Sdata.DrawCalls = 1;
 	
 	// draw the outline of the starting box of fluid
 	if (paused) {
 		Sdata.Container->SetTranslation(Sdata.BoxPosition);
 		Sdata.Container->SetRotation(0.0f);
 		Sdata.Container->SetScale(Sdata.BoxScale);
-		containerShader->SetUniformMatrix4f("u_Model", Sdata.Container->GetTransform());
+		containerShader->SetUniform(Sdata.ContainerModel, Sdata.Container->GetTransform());
 		glBindVertexArray(Sdata.Container->GetVAO());
 		glDrawElements(GL_LINE_LOOP, (GLsizei)Sdata.Container->GetIndices().size(), GL_UNSIGNED_INT, nullptr);
+		Sdata.DrawCalls++;
 	}
 	
-	// then go through all the molecules and render them normally
-	std::vector<SPHSolver::MoleculeProperties> properties = SPHSolver::GetProperties();
-	moleculeShader->Use();
-	glBindVertexArray(Sdata.MoleculeMesh->GetVAO());
+	// the molecules of one level of detail share a mesh, so they are drawn as instances of it in a single call
+	// the shader adds the position of each instance to the shared scale of the mesh
+	// the solver state is packed straight into the mapped slots of the instance rings
+	const uint32_t impostorLevel = Renderer::Scene::NumLevels - 1;
+	uint32_t firstLevel = 0;
+	uint32_t lastLevel = 0;
+	if (Sdata.Geometry == (int)Renderer::Scene::Geometry::IMPOSTOR) {
+		firstLevel = impostorLevel;
+		lastLevel = impostorLevel;
+	}
+	else if (Sdata.Geometry == (int)Renderer::Scene::Geometry::LOD) {
+		lastLevel = impostorLevel;
+	}
+
+	// a molecule takes the first level whose smallest size on screen it reaches, which is a largest view depth
+	float depthLimits[Renderer::Scene::NumLevels];
+	for (uint32_t l = 0; l < impostorLevel; l++) {
+		depthLimits[l] = 0.5f * Sdata.MoleculeScale * Sdata.PixelScale / LevelRadii[l];
+	}
+	depthLimits[impostorLevel] = FLT_MAX;
+
+	Mesh::InstanceData* instances[Renderer::Scene::NumLevels] = {};
+	uint32_t counts[Renderer::Scene::NumLevels] = {};
+	for (uint32_t l = firstLevel; l <= lastLevel; l++) {
+		instances[l] = Sdata.Levels[l]->MapInstances(Renderer::Scene::NumMolecules);
+	}
+	const SPHSolver::MoleculeProperties& properties = SPHSolver::GetProperties();
+	const glm::mat4& view = Sdata.View;
 	for (uint32_t i = 0; i < Renderer::Scene::NumMolecules; i++) {
-		const SPHSolver::MoleculeProperties& p = properties[i];
-		Sdata.MoleculeMesh->SetTranslation(p.Position);
-		moleculeShader->SetUniformMatrix4f("u_Model", Sdata.MoleculeMesh->GetTransform());
-		moleculeShader->SetUniformFloat("u_SpeedSq", glm::dot(p.Velocity, p.Velocity));
-		glDrawElements(GL_TRIANGLES, (GLsizei)Sdata.MoleculeMesh->GetIndices().size(), GL_UNSIGNED_INT, nullptr);
+		const glm::vec3 position = properties.GetPosition(i);
+		uint32_t level = firstLevel;
+		if (firstLevel != lastLevel) {
+			const float depth = -(view[0][2] * position.x + view[1][2] * position.y + view[2][2] * position.z + view[3][2]);
+			while (depth > depthLimits[level]) {
+				level++;
+			}
+		}
+		if (instances[level] != nullptr) {
+			instances[level][counts[level]++] = Mesh::PackInstance(position, glm::length(properties.GetVelocity(i)));
+		}
 	}
+
+	Sdata.UploadBytes = 0;
+	Sdata.MoleculeVertices = 0;
+	Sdata.MoleculeMesh->SetTranslation(glm::vec3(0.0f));
+	for (uint32_t l = firstLevel; l <= lastLevel; l++) {
+		if (instances[l] == nullptr) {
+			continue;
+		}
+		if (l == impostorLevel) {
+			impostorShader->SetUniform(Sdata.ImpostorScale, Sdata.MoleculeScale);
+		}
+		else {
+			moleculeShader->SetUniform(Sdata.MoleculeModel, Sdata.MoleculeMesh->GetTransform());
+		}
+		// an empty level still gets its slot unmapped and fenced
+		Sdata.Levels[l]->DrawInstances(counts[l]);
+		Sdata.DrawCalls += counts[l] > 0 ? 1 : 0;
+		Sdata.UploadBytes += counts[l] * sizeof(Mesh::InstanceData);
+		Sdata.MoleculeVertices += Sdata.Levels[l]->GetVertexCount() * counts[l];
+	}
+	std::copy(counts, counts + Renderer::Scene::NumLevels, Sdata.LevelCounts);
+}
+
+uint32_t Renderer::Scene::GetDrawCalls()
+{
+	return Sdata.DrawCalls;
+}
+
+const uint32_t* Renderer::Scene::GetLevelCounts()
+{
+	return Sdata.LevelCounts;
+}
+
+size_t Renderer::Scene::GetMoleculeVertices()
+{
+	return Sdata.MoleculeVertices;
+}
+
+size_t Renderer::Scene::GetUploadBytes()
+{
+	return Sdata.UploadBytes;
+}
+
+bool Renderer::Scene::IsUploadPersistent()
+{
+	return Sdata.MoleculeMesh->IsPersistentlyMapped();
 }
 
 const glm::vec3 Renderer::Scene::GetContainerBounds()
@@ -225,3 +483,27 @@ float Renderer::Scene::GetDeltaTime()
 {
 	return Sdata.Delta;
 }
+
+float Renderer::Scene::GetStepBudget()
+{
+	return Sdata.StepBudget;
+}
+
+SPHSolver::SimulationConfig Renderer::Scene::GetSimulationConfig()
+{
+	SPHSolver::SimulationConfig config;
+	config.NumMolecules = Renderer::Scene::NumMolecules;
+	config.StartingBoxPosition = glm::vec3(Sdata.BoxPosition.x, Sdata.BoxPosition.y, 0.0f);
+	config.StartingBoxScale = glm::vec3(Sdata.BoxScale.x, Sdata.BoxScale.y, 1.0f);
+	config.MoleculeScale = Sdata.MoleculeScale;
+	config.InfluenceRadius = Sdata.InfluenceRadius;
+	config.ViscosityStrength = Sdata.Viscosity;
+	config.Sort = (SPHSolver::SortMethod)Sdata.SortMethod;
+	config.Indexing = (SPHSolver::CellIndexing)Sdata.CellIndexing;
+	config.NeighbourLists = Sdata.NeighbourLists;
+	config.SkinDistance = Sdata.SkinDistance;
+	config.SymmetricPairs = Sdata.SymmetricPairs;
+	config.GrainSize = (uint32_t)Sdata.GrainSize;
+	config.Partition = (SPHSolver::WorkPartition)Sdata.Partition;
+	return config;
+}
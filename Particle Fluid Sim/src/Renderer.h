@@ -5,6 +5,7 @@
 #include "ImGui/imgui_impl_opengl3.h"
 
 #include "Mesh.h"
+#include "SPHSolver.h"
 
 struct GLFWwindow;
 
@@ -43,14 +44,28 @@ public:
 	private:
 		UI() = default;
 
+		// the per section timings of the profiler as a table and a stacked graph of the recorded frames
+		static void FrameBreakdown();
+
 	};
 
 	class Scene
 	{
 	public:
-		static void Init();
+		// how the molecules are drawn
+		enum class Geometry
+		{
+			MESH,      // the full sphere mesh
+			IMPOSTOR,  // a camera-facing quad the shader draws the sphere into
+			LOD        // a coarser sphere or the quad, picked per molecule by its size on screen
+		};
+
+	public:
+		// resolves the uniforms the scene sets every frame
+		static void Init(Ref<Shader>& containerShader, Ref<Shader>& moleculeShader, Ref<Shader>& impostorShader);
 		
-		static void Render(Ref<Shader>& containershd, Ref<Shader>& moleculeshd, bool paused);
+		// the molecules are drawn as sphere meshes, as camera-facing impostor quads or as a mix of levels of detail
+		static void Render(Ref<Shader>& containershd, Ref<Shader>& moleculeshd, Ref<Shader>& impostorshd, bool paused);
 
 		static const glm::vec3 GetContainerBounds();
 		static float GetInfluenceRadius();
@@ -60,9 +75,22 @@ public:
 		static glm::mat4 GetContainerTransform();
 		static float GetContainerRotation();
 		static float GetDeltaTime();
+		static float GetStepBudget();
+		// the levels of detail are picked with the camera of the frame
+		static void SetCamera(const glm::mat4& view, const glm::mat4& projection, float viewportHeight);
+
+		static uint32_t GetDrawCalls();
+		// the molecules drawn at every level of detail, from the full sphere to the impostor
+		static const uint32_t* GetLevelCounts();
+		static size_t GetMoleculeVertices();
+		static size_t GetUploadBytes();
+		static bool IsUploadPersistent();
+		// the solver parameters currently set through the UI
+		static SPHSolver::SimulationConfig GetSimulationConfig();
 
 	public:
 		static constexpr uint32_t NumMolecules = 2048;
+		static constexpr uint32_t NumLevels = 4;
 
 	private:
 		Scene() = default;
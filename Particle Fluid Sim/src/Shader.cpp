@@ -4,6 +4,8 @@
 #include <iostream>
 #include <sstream>
 
+static GLuint s_BoundProgram = 0;  // the program of the last Shader::Use
+
 // retrieves the shader code from files and binds them into a single program
 Shader::Shader(const std::string& vertexPath, const std::string& fragmentPath)
 {
@@ -82,27 +84,117 @@ Shader::Shader(const std::string& vertexPath, const std::string& fragmentPath)
 	// only the shader program is used
 	glDeleteShader(vertex);
 	glDeleteShader(fragment);
+
+	ReflectUniforms();
 }
 
 Shader::~Shader()
 {
+	if (s_BoundProgram == m_ID) {
+		s_BoundProgram = 0;
+	}
 	glDeleteProgram(m_ID);
 }
 
 void Shader::Use()
 {
 	// bind the shader
-	glUseProgram(m_ID);
+	if (s_BoundProgram != m_ID) {
+		glUseProgram(m_ID);
+		s_BoundProgram = m_ID;
+	}
 }
 
-void Shader::SetUniformFloat(const std::string& name, float value)
+void Shader::ReflectUniforms()
+{
+	GLint count = 0;
+	GLint maxLength = 0;
+	glGetProgramiv(m_ID, GL_ACTIVE_UNIFORMS, &count);
+	glGetProgramiv(m_ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+	std::string name(maxLength, '\0');
+	for (GLint i = 0; i < count; i++) {
+		GLsizei length = 0;
+		GLint size = 0;
+		GLenum type = 0;
+		glGetActiveUniform(m_ID, (GLuint)i, maxLength, &length, &size, &type, name.data());
+		// the members of uniform blocks have no location
+		const GLint location = glGetUniformLocation(m_ID, name.c_str());
+		if (location == -1) {
+			continue;
+		}
+		// arrays are reported as their first element, they are looked up by their name
+		std::string key = name.substr(0, length);
+		if (key.size() > 3 && key.compare(key.size() - 3, 3, "[0]") == 0) {
+			key.resize(key.size() - 3);
+		}
+		m_Uniforms[key] = location;
+	}
+}
+
+GLint Shader::FindUniform(const std::string& name) const
+{
+	auto uniform = m_Uniforms.find(name);
+	if (uniform == m_Uniforms.end()) {
+		std::cout << "Error Shader::FindUniform: no active uniform " << name << std::endl;
+		return -1;
+	}
+	return uniform->second;
+}
+
+void Shader::SetUniform(UniformHandle<float> handle, float value)
 {
 	this->Use();
-	glUniform1f(glGetUniformLocation(m_ID, name.c_str()), value);
+	glUniform1f(handle.Location, value);
 }
 
-void Shader::SetUniformMatrix4f(const std::string& name, const glm::mat4& mat)
+void Shader::SetUniform(UniformHandle<glm::mat4> handle, const glm::mat4& mat)
 {
 	this->Use();
-	glUniformMatrix4fv(glGetUniformLocation(m_ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+	glUniformMatrix4fv(handle.Location, 1, GL_FALSE, &mat[0][0]);
+}
+
+void Shader::SetUniformFloat(const std::string& name, float value)
+{
+	SetUniform(GetUniform<float>(name), value);
+}
+
+void Shader::SetUniformMatrix4f(const std::string& name, const glm::mat4& mat)
+{
+	SetUniform(GetUniform<glm::mat4>(name), mat);
+}
+
+void Shader::BindUniformBlock(const std::string& name, const UniformBuffer& buffer)
+{
+	const GLuint index = glGetUniformBlockIndex(m_ID, name.c_str());
+	if (index == GL_INVALID_INDEX) {
+		std::cout << "Error Shader::BindUniformBlock: no active uniform block " << name << std::endl;
+		return;
+	}
+	glUniformBlockBinding(m_ID, index, buffer.GetBinding());
+}
+
+UniformBuffer::UniformBuffer(size_t size, GLuint binding)
+	: m_Binding(binding)
+{
+	glGenBuffers(1, &m_ID);
+	glBindBuffer(GL_UNIFORM_BUFFER, m_ID);
+	glBufferData(GL_UNIFORM_BUFFER, (GLsizeiptr)size, nullptr, GL_DYNAMIC_DRAW);
+	glBindBufferBase(GL_UNIFORM_BUFFER, m_Binding, m_ID);
+}
+
+UniformBuffer::~UniformBuffer()
+{
+	glDeleteBuffers(1, &m_ID);
+}
+
+void UniformBuffer::SetData(const void* data, size_t size, size_t offset)
+{
+	glBindBuffer(GL_UNIFORM_BUFFER, m_ID);
+	glBufferSubData(GL_UNIFORM_BUFFER, (GLintptr)offset, (GLsizeiptr)size, data);
+}
+
+GLuint UniformBuffer::GetBinding() const
+{
+	return m_Binding;
 }
@@ -8,6 +8,30 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include <string>
+#include <unordered_map>
+
+// the location of a uniform, looked up once and typed by the value it takes
+template<typename T>
+struct UniformHandle
+{
+	GLint Location = -1;
+};
+
+// a buffer of uniforms, shared by every shader whose block is bound to its binding point
+class UniformBuffer
+{
+public:
+	UniformBuffer(size_t size, GLuint binding);
+	~UniformBuffer();
+
+	void SetData(const void* data, size_t size, size_t offset = 0);
+	GLuint GetBinding() const;
+
+private:
+	GLuint m_ID;
+	GLuint m_Binding;
+
+};
 
 // basic shader type
 class Shader
@@ -17,12 +41,27 @@ public:
 	Shader(const std::string& vertexPath, const std::string& fragmentPath);
 	~Shader();
 
+	// only binds the program when another one is bound
 	void Use();
 
+	template<typename T>
+	UniformHandle<T> GetUniform(const std::string& name) const { return { FindUniform(name) }; }
+	void SetUniform(UniformHandle<float> handle, float value);
+	void SetUniform(UniformHandle<glm::mat4> handle, const glm::mat4& mat);
+
+	// look the name up on every call, handles are cheaper for uniforms set every frame
 	void SetUniformFloat(const std::string& name, float value);
 	void SetUniformMatrix4f(const std::string& name, const glm::mat4& mat);
 
+	void BindUniformBlock(const std::string& name, const UniformBuffer& buffer);
+
+private:
+	// stores the location of every active uniform once the program is linked
+	void ReflectUniforms();
+	GLint FindUniform(const std::string& name) const;
+
 private:
 	GLuint m_ID;
+	std::unordered_map<std::string, GLint> m_Uniforms;
 
 };
\ No newline at end of file
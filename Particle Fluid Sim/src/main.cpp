@@ -1,11 +1,19 @@
 #include "Core.h"
 #include "Application.h"
 
-int main()
+#include <cstring>
+
+// usage: "Particle Fluid Sim" [--trace file.json], the trace of the last frames is also written on exit
+int main(int argc, char** argv)
 {
 	bool result;
 	Application app("Particle-based fluid simulation", &result);
 	if (result == true) {
+		for (int i = 1; i + 1 < argc; i++) {
+			if (std::strcmp(argv[i], "--trace") == 0) {
+				app.SetTraceFile(argv[++i], true);
+			}
+		}
 		app.Run();
 	}
 	return 0;
@@ -0,0 +1,190 @@
+#include "Scenario.h"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+static std::string Trim(const std::string& text)
+{
+	const size_t first = text.find_first_not_of(" \t\r");
+	if (first == std::string::npos) {
+		return "";
+	}
+	const size_t last = text.find_last_not_of(" \t\r");
+	return text.substr(first, last - first + 1);
+}
+
+// the whole value has to be consumed, so "0.5x" is rejected instead of read as 0.5
+template <typename T>
+static bool ParseValue(const std::string& value, T& result)
+{
+	std::istringstream stream(value);
+	T parsed;
+	if (!(stream >> parsed) || !(stream >> std::ws).eof()) {
+		return false;
+	}
+	result = parsed;
+	return true;
+}
+
+static bool ParseBool(const std::string& value, bool& result)
+{
+	if (value == "true" || value == "1") {
+		result = true;
+		return true;
+	}
+	if (value == "false" || value == "0") {
+		result = false;
+		return true;
+	}
+	return false;
+}
+
+// "x y" or "x y z", a missing z keeps its previous value
+static bool ParseVec3(const std::string& value, glm::vec3& result)
+{
+	std::istringstream stream(value);
+	glm::vec3 parsed = result;
+	if (!(stream >> parsed.x >> parsed.y)) {
+		return false;
+	}
+	if (!(stream >> std::ws).eof() && !(stream >> parsed.z)) {
+		return false;
+	}
+	if (!(stream >> std::ws).eof()) {
+		return false;
+	}
+	result = parsed;
+	return true;
+}
+
+bool Scenario::Set(const std::string& key, const std::string& value)
+{
+	bool valid = false;
+	if (key == "molecules") {
+		valid = ParseValue(value, Config.NumMolecules) && Config.NumMolecules > 0;
+	}
+	else if (key == "threads") {
+		valid = ParseValue(value, Config.NumThreads);
+	}
+	else if (key == "box_position") {
+		valid = ParseVec3(value, Config.StartingBoxPosition);
+	}
+	else if (key == "box_scale") {
+		valid = ParseVec3(value, Config.StartingBoxScale);
+	}
+	else if (key == "container_position") {
+		valid = ParseVec3(value, ContainerPosition);
+	}
+	else if (key == "container_rotation") {
+		valid = ParseValue(value, ContainerRotation);
+	}
+	else if (key == "container_scale") {
+		valid = ParseVec3(value, ContainerScale);
+	}
+	else if (key == "molecule_scale") {
+		valid = ParseValue(value, Config.MoleculeScale);
+	}
+	else if (key == "influence_radius") {
+		valid = ParseValue(value, Config.InfluenceRadius) && Config.InfluenceRadius > 0.0f;
+	}
+	else if (key == "viscosity") {
+		valid = ParseValue(value, Config.ViscosityStrength);
+	}
+	else if (key == "sort") {
+		valid = value == "counting" || value == "comparison" || value == "incremental";
+		Config.Sort = value == "comparison" ? SPHSolver::SortMethod::COMPARISON
+			: value == "incremental" ? SPHSolver::SortMethod::INCREMENTAL : SPHSolver::SortMethod::COUNTING;
+	}
+	else if (key == "indexing") {
+		valid = value == "dense" || value == "hash" || value == "morton";
+		Config.Indexing = value == "hash" ? SPHSolver::CellIndexing::HASH
+			: value == "morton" ? SPHSolver::CellIndexing::MORTON : SPHSolver::CellIndexing::DENSE;
+	}
+	else if (key == "neighbour_lists") {
+		valid = ParseBool(value, Config.NeighbourLists);
+	}
+	else if (key == "skin_distance") {
+		valid = ParseValue(value, Config.SkinDistance) && Config.SkinDistance >= 0.0f;
+	}
+	else if (key == "symmetric_pairs") {
+		valid = ParseBool(value, Config.SymmetricPairs);
+	}
+	else if (key == "partition") {
+		valid = value == "cost" || value == "chunks";
+		Config.Partition = value == "chunks" ? SPHSolver::WorkPartition::CHUNKS : SPHSolver::WorkPartition::COST;
+	}
+	else if (key == "grain_size") {
+		valid = ParseValue(value, Config.GrainSize);
+	}
+	else if (key == "dt") {
+		valid = ParseValue(value, DeltaTime) && DeltaTime > 0.0f;
+	}
+	else if (key == "substeps") {
+		valid = ParseValue(value, Substeps) && Substeps > 0;
+	}
+	else if (key == "frames") {
+		valid = ParseValue(value, Frames);
+	}
+	else if (key == "output_interval") {
+		valid = ParseValue(value, OutputInterval);
+	}
+	else if (key == "seed") {
+		valid = ParseValue(value, Seed);
+	}
+	else if (key == "output_directory") {
+		valid = !value.empty();
+		OutputDirectory = value;
+	}
+	else if (key == "trace_file") {
+		valid = true;
+		TraceFile = value;
+	}
+	else {
+		std::cout << "Error Scenario::Set: unknown key \"" << key << "\"" << std::endl;
+		return false;
+	}
+
+	if (!valid) {
+		std::cout << "Error Scenario::Set: invalid value \"" << value << "\" for \"" << key << "\"" << std::endl;
+	}
+	return valid;
+}
+
+bool Scenario::Load(const std::string& path)
+{
+	std::ifstream file(path);
+	if (!file.is_open()) {
+		std::cout << "Error Scenario::Load: could not open " << path << std::endl;
+		return false;
+	}
+
+	std::string line;
+	uint32_t lineNumber = 0;
+	while (std::getline(file, line)) {
+		lineNumber++;
+		line = Trim(line);
+		if (line.empty() || line[0] == '#') {
+			continue;
+		}
+		const size_t separator = line.find('=');
+		if (separator == std::string::npos) {
+			std::cout << "Error Scenario::Load: expected \"key = value\" on line " << lineNumber << " of " << path << std::endl;
+			return false;
+		}
+		if (!Scenario::Set(Trim(line.substr(0, separator)), Trim(line.substr(separator + 1)))) {
+			std::cout << "Error Scenario::Load: on line " << lineNumber << " of " << path << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+glm::mat4 Scenario::GetContainerTransform() const
+{
+	glm::mat4 transform = glm::mat4(1.0f);
+	transform = glm::translate(transform, ContainerPosition);
+	transform = glm::rotate(transform, glm::radians(ContainerRotation), glm::vec3(0.0f, 0.0f, 1.0f));
+	transform = glm::scale(transform, ContainerScale);
+	return transform;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "SPHSolver.h"
+
+// everything a batch run needs, read from a text file of "key = value" lines
+// lines starting with '#' are comments, keys that are not set keep the defaults of the application
+struct Scenario
+{
+	SPHSolver::SimulationConfig Config;
+	glm::vec3 ContainerPosition = glm::vec3(0.0f, 0.0f, 0.0f);
+	float ContainerRotation = 0.0f;  // in degrees, around z
+	glm::vec3 ContainerScale = glm::vec3(41.0f, 23.0f, 1.0f);
+	float DeltaTime = 0.001666f;  // the time of one frame, split evenly between the substeps
+	uint32_t Substeps = 7;
+	uint32_t Frames = 1000;
+	uint32_t OutputInterval = 0;  // a frame file every this many frames, 0 only writes the timings
+	uint32_t Seed = 0;
+	std::string OutputDirectory = "batch_output";
+	std::string TraceFile;  // a Chrome trace of the last frames in the output directory, empty records nothing
+
+	// both return false and log the offending line on a malformed or unknown entry
+	bool Load(const std::string& path);
+	bool Set(const std::string& key, const std::string& value);
+
+	// the same transform Renderer::Scene gives the container mesh
+	glm::mat4 GetContainerTransform() const;
+};
@@ -0,0 +1,135 @@
+#include "Scenario.h"
+
+#include "SPHSolver.h"
+#include "CollisionSolver.h"
+#include "Random.h"
+#include "Tracer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+// runs a scenario without a window or an OpenGL context
+// usage: sphbatch <scenario file> [key=value ...], the pairs override the entries of the file
+
+// the molecules are reordered by the neighbour search, so the rows of two frames do not line up
+static bool WriteFrame(const std::filesystem::path& path)
+{
+	std::ofstream file(path);
+	if (!file.is_open()) {
+		std::cout << "Error WriteFrame: could not open " << path.string() << std::endl;
+		return false;
+	}
+	const SPHSolver::MoleculeProperties& props = SPHSolver::GetProperties();
+	file << "x,y,z,vx,vy,vz,density\n";
+	char row[160];
+	for (uint32_t i = 0; i < SPHSolver::GetNumMolecules(); i++) {
+		std::snprintf(row, sizeof(row), "%g,%g,%g,%g,%g,%g,%g\n",
+			props.PositionX[i], props.PositionY[i], props.PositionZ[i],
+			props.VelocityX[i], props.VelocityY[i], props.VelocityZ[i], props.Density[i]);
+		file << row;
+	}
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2) {
+		std::cout << "usage: sphbatch <scenario file> [key=value ...]" << std::endl;
+		return 1;
+	}
+
+	Scenario scenario;
+	if (!scenario.Load(argv[1])) {
+		return 1;
+	}
+	for (int i = 2; i < argc; i++) {
+		const std::string argument = argv[i];
+		const size_t separator = argument.find('=');
+		if (separator == std::string::npos) {
+			std::cout << "Error main: expected key=value, got \"" << argument << "\"" << std::endl;
+			return 1;
+		}
+		if (!scenario.Set(argument.substr(0, separator), argument.substr(separator + 1))) {
+			return 1;
+		}
+	}
+
+	const std::filesystem::path outputDirectory = scenario.OutputDirectory;
+	std::error_code error;
+	std::filesystem::create_directories(outputDirectory, error);
+	if (error) {
+		std::cout << "Error main: could not create " << outputDirectory.string() << ": " << error.message() << std::endl;
+		return 1;
+	}
+
+	// the rings of the solver workers are allocated when the pool starts, so tracing is enabled before
+	if (!scenario.TraceFile.empty()) {
+		Tracer::SetEnabled(true);
+		Tracer::RegisterThread("Main thread");
+	}
+
+	Random::Seed(scenario.Seed);
+	SPHSolver::Init(scenario.Config);
+	const CollisionSolver::ContainerState container = CollisionSolver::MakeContainerState(
+		scenario.GetContainerTransform(), scenario.ContainerRotation);
+	const float dt = scenario.DeltaTime / scenario.Substeps;
+
+	// only the solver steps are timed, writing the frames is left out
+	std::vector<double> frameTimes(scenario.Frames);
+	for (uint32_t frame = 0; frame < scenario.Frames; frame++) {
+		const auto start = std::chrono::steady_clock::now();
+		{
+			TraceScope trace("Frame");
+			for (uint32_t step = 0; step < scenario.Substeps; step++) {
+				SPHSolver::Update(dt, scenario.Config, container);
+			}
+		}
+		const auto end = std::chrono::steady_clock::now();
+		frameTimes[frame] = std::chrono::duration<double, std::milli>(end - start).count();
+
+		if (scenario.OutputInterval > 0 && (frame + 1) % scenario.OutputInterval == 0) {
+			char name[32];
+			std::snprintf(name, sizeof(name), "frame_%06u.csv", frame + 1);
+			if (!WriteFrame(outputDirectory / name)) {
+				return 1;
+			}
+		}
+	}
+
+	std::ofstream timings(outputDirectory / "timings.csv");
+	if (!timings.is_open()) {
+		std::cout << "Error main: could not write the timings to " << outputDirectory.string() << std::endl;
+		return 1;
+	}
+	timings << "frame,milliseconds\n";
+	for (uint32_t frame = 0; frame < scenario.Frames; frame++) {
+		timings << frame + 1 << "," << frameTimes[frame] << "\n";
+	}
+
+	// the rings only hold the last frames of a long run
+	if (!scenario.TraceFile.empty() && !Tracer::Dump((outputDirectory / scenario.TraceFile).string())) {
+		return 1;
+	}
+
+	double total = 0.0;
+	for (double time : frameTimes) {
+		total += time;
+	}
+	const uint64_t steps = (uint64_t)scenario.Frames * scenario.Substeps;
+	const double mean = scenario.Frames > 0 ? total / scenario.Frames : 0.0;
+	const double fastest = scenario.Frames > 0 ? *std::min_element(frameTimes.begin(), frameTimes.end()) : 0.0;
+	const double slowest = scenario.Frames > 0 ? *std::max_element(frameTimes.begin(), frameTimes.end()) : 0.0;
+	const double perMolecule = steps > 0 ? total * 1.0e6 / ((double)steps * scenario.Config.NumMolecules) : 0.0;
+
+	std::printf("%u molecules, %u threads, %u frames of %u steps\n",
+		scenario.Config.NumMolecules, SPHSolver::GetNumThreads(), scenario.Frames, scenario.Substeps);
+	std::printf("total %.3f s, frame mean %.3f ms, min %.3f ms, max %.3f ms\n", total / 1000.0, mean, fastest, slowest);
+	std::printf("%.2f ns per molecule per step\n", perMolecule);
+	std::printf("%.1f%% of the worker time in the passes idle at barriers\n", 100.0f * SPHSolver::SampleBarrierIdle());
+	return 0;
+}
@@ -0,0 +1,57 @@
+#!/usr/bin/env python3
+# compares two result files of sphbench, usage: compare.py <baseline.json> <candidate.json> [--threshold percent]
+# every phase present in both files is listed, changes beyond the threshold are marked as faster or SLOWER
+# the exit code is 1 when any phase got slower, so the script can gate a build
+
+import argparse
+import json
+import sys
+
+PHASES = ["predict", "check_neighbours", "density", "force", "collisions", "update"]
+
+
+def load(path):
+    with open(path) as file:
+        data = json.load(file)
+    return data, {(r["molecules"], r["threads"]): r for r in data["results"]}
+
+
+def main():
+    parser = argparse.ArgumentParser(description="compare two sphbench result files")
+    parser.add_argument("baseline")
+    parser.add_argument("candidate")
+    parser.add_argument("--threshold", type=float, default=5.0, help="the change in percent that counts as a difference")
+    args = parser.parse_args()
+
+    base_info, base = load(args.baseline)
+    cand_info, cand = load(args.candidate)
+    for key in ("kernels", "hardware_threads", "symmetric_pairs", "neighbour_lists", "grain_size", "partition", "indexing", "sort"):
+        if base_info.get(key) != cand_info.get(key):
+            print(f"note: {key} differs, {base_info.get(key)} -> {cand_info.get(key)}")
+
+    print(f"{'molecules':>10} {'threads':>8} {'phase':>18} {'baseline':>10} {'candidate':>10} {'change':>9}")
+    slower = 0
+    for key in sorted(base.keys() & cand.keys()):
+        for phase in PHASES:
+            if phase not in base[key] or phase not in cand[key]:
+                continue
+            before = base[key][phase]
+            after = cand[key][phase]
+            change = 100.0 * (after - before) / before if before > 0 else 0.0
+            mark = ""
+            if change > args.threshold:
+                mark = "SLOWER"
+                slower += 1
+            elif change < -args.threshold:
+                mark = "faster"
+            print(f"{key[0]:>10} {key[1]:>8} {phase:>18} {before:>10.2f} {after:>10.2f} {change:>+8.1f}% {mark}")
+
+    missing = base.keys() ^ cand.keys()
+    if missing:
+        print(f"note: {len(missing)} molecule/thread combinations are only in one of the files")
+    print(f"{slower} phases slower than {args.threshold}%")
+    return 1 if slower > 0 else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,277 @@
+#include "SPHSolver.h"
+#include "CollisionSolver.h"
+#include "SolverKernels.h"
+#include "Random.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// times every phase of a solver step on the dam break scene of the application,
+// for a sweep of molecule counts and worker counts
+// usage: sphbench [--min-molecules n] [--max-molecules n] [--max-threads n] [--symmetric] [--lists] [--grain n] [--partition chunks|cost] [--indexing hash|dense|morton] [--sort comparison|counting|incremental] [--output file.json]
+
+static constexpr uint32_t Seed = 1;
+static constexpr float TimeStep = 0.001666f;
+static constexpr uint32_t WarmupSteps = 5;
+
+enum Phase
+{
+	PREDICT, CHECK_NEIGHBOURS, DENSITY, FORCE, COLLISIONS, UPDATE, PHASE_COUNT
+};
+
+static const char* IndexingNames[] = { "hash", "dense", "morton" };
+static const char* SortNames[] = { "comparison", "counting", "incremental" };
+
+static const char* PhaseNames[PHASE_COUNT] = { "predict", "check_neighbours", "density", "force", "collisions", "update" };
+
+struct BenchResult
+{
+	uint32_t Molecules;
+	uint32_t Threads;
+	uint32_t Steps;
+	double NanosecondsPerMolecule[PHASE_COUNT];  // the median of all the steps, divided by the molecule count
+};
+
+struct BenchOptions
+{
+	uint32_t MinMolecules = 1024;
+	uint32_t MaxMolecules = 1024 * 1024;
+	uint32_t MaxThreads = std::max(1u, std::thread::hardware_concurrency());
+	bool Symmetric = false;
+	bool Lists = false;
+	uint32_t GrainSize = 0;
+	SPHSolver::WorkPartition Partition = SPHSolver::WorkPartition::COST;
+	SPHSolver::CellIndexing Indexing = SPHSolver::CellIndexing::DENSE;
+	SPHSolver::SortMethod Sort = SPHSolver::SortMethod::COUNTING;
+	std::string Output = "bench_results.json";
+};
+
+// the starting scene of the application, scaled so every molecule count fills the box with the same density
+static SPHSolver::SimulationConfig MakeDamBreak(uint32_t molecules, uint32_t threads, const BenchOptions& options, glm::mat4& containerTransform)
+{
+	const float scale = std::sqrt((float)molecules / 2048.0f);
+	SPHSolver::SimulationConfig config;
+	config.NumMolecules = molecules;
+	config.NumThreads = threads;
+	config.StartingBoxPosition = glm::vec3(-16.0f * scale, 0.0f, 0.0f);
+	config.StartingBoxScale = glm::vec3(7.0f * scale, 21.0f * scale, 1.0f);
+	config.NeighbourLists = options.Lists;
+	config.SymmetricPairs = options.Symmetric;
+	config.GrainSize = options.GrainSize;
+	config.Partition = options.Partition;
+	config.Indexing = options.Indexing;
+	config.Sort = options.Sort;
+	containerTransform = glm::scale(glm::mat4(1.0f), glm::vec3(41.0f * scale, 23.0f * scale, 1.0f));
+	return config;
+}
+
+static double Median(std::vector<double>& samples)
+{
+	std::sort(samples.begin(), samples.end());
+	const size_t middle = samples.size() / 2;
+	return samples.size() % 2 == 1 ? samples[middle] : 0.5 * (samples[middle - 1] + samples[middle]);
+}
+
+static BenchResult RunBenchmark(uint32_t molecules, uint32_t threads, const BenchOptions& options)
+{
+	using Clock = std::chrono::steady_clock;
+
+	Random::Seed(Seed);
+	glm::mat4 containerTransform;
+	const SPHSolver::SimulationConfig config = MakeDamBreak(molecules, threads, options, containerTransform);
+	const CollisionSolver::ContainerState container = CollisionSolver::MakeContainerState(containerTransform, 0.0f);
+	SPHSolver::Init(config);
+
+	// the first steps grow the tables and let the fluid leave the perfectly random start
+	for (uint32_t i = 0; i < WarmupSteps; i++) {
+		SPHSolver::Update(TimeStep, config, container);
+	}
+
+	// about the same amount of work for every molecule count, but never less than a few samples
+	BenchResult result;
+	result.Molecules = molecules;
+	result.Threads = threads;
+	result.Steps = std::clamp(4000000u / molecules, 5u, 200u);
+
+	std::vector<double> samples[PHASE_COUNT];
+	for (auto& phase : samples) {
+		phase.reserve(result.Steps);
+	}
+	// the phases are the profiler sections of one real step, timed separately they would skip the prediction
+	// and, with neighbour lists, reorder the molecules under lists that are still in use
+	Profiler::EndFrame();
+	for (uint32_t i = 0; i < result.Steps; i++) {
+		const Clock::time_point start = Clock::now();
+		SPHSolver::Update(TimeStep, config, container);
+		const Clock::time_point end = Clock::now();
+		Profiler::EndFrame();
+
+		const uint32_t frame = Profiler::GetFrameCount() - 1;
+		auto nanoseconds = [frame](Profiler::Section section) {
+			return 1.0e6 * Profiler::GetHistory(section, frame);
+		};
+		samples[PREDICT].push_back(nanoseconds(Profiler::Section::PREDICT));
+		samples[CHECK_NEIGHBOURS].push_back(nanoseconds(Profiler::Section::LISTS) + nanoseconds(Profiler::Section::HASH)
+			+ nanoseconds(Profiler::Section::SORT) + nanoseconds(Profiler::Section::REORDER) + nanoseconds(Profiler::Section::PARTITION));
+		samples[DENSITY].push_back(nanoseconds(Profiler::Section::DENSITY));
+		samples[FORCE].push_back(nanoseconds(Profiler::Section::FORCE));
+		samples[COLLISIONS].push_back(nanoseconds(Profiler::Section::COLLISION));
+		samples[UPDATE].push_back(std::chrono::duration<double, std::nano>(end - start).count());
+	}
+	for (uint32_t p = 0; p < PHASE_COUNT; p++) {
+		result.NanosecondsPerMolecule[p] = Median(samples[p]) / molecules;
+	}
+	return result;
+}
+
+static bool WriteJson(const std::string& path, const BenchOptions& options, const std::vector<BenchResult>& results)
+{
+	std::ofstream file(path);
+	if (!file.is_open()) {
+		std::cout << "Error WriteJson: could not open " << path << std::endl;
+		return false;
+	}
+	file << "{\n";
+	file << "  \"scene\": \"dam_break\",\n";
+	file << "  \"seed\": " << Seed << ",\n";
+	file << "  \"kernels\": \"" << SolverKernels::GetISAName() << "\",\n";
+	file << "  \"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n";
+	file << "  \"symmetric_pairs\": " << (options.Symmetric ? "true" : "false") << ",\n";
+	file << "  \"neighbour_lists\": " << (options.Lists ? "true" : "false") << ",\n";
+	file << "  \"grain_size\": " << options.GrainSize << ",\n";
+	file << "  \"partition\": \"" << (options.Partition == SPHSolver::WorkPartition::CHUNKS ? "chunks" : "cost") << "\",\n";
+	file << "  \"indexing\": \"" << IndexingNames[(int)options.Indexing] << "\",\n";
+	file << "  \"sort\": \"" << SortNames[(int)options.Sort] << "\",\n";
+	file << "  \"unit\": \"ns/molecule/step\",\n";
+	file << "  \"results\": [\n";
+	char number[32];
+	for (size_t r = 0; r < results.size(); r++) {
+		const BenchResult& result = results[r];
+		file << "    { \"molecules\": " << result.Molecules << ", \"threads\": " << result.Threads << ", \"steps\": " << result.Steps;
+		for (uint32_t p = 0; p < PHASE_COUNT; p++) {
+			std::snprintf(number, sizeof(number), "%.3f", result.NanosecondsPerMolecule[p]);
+			file << ", \"" << PhaseNames[p] << "\": " << number;
+		}
+		file << (r + 1 < results.size() ? " },\n" : " }\n");
+	}
+	file << "  ]\n}\n";
+	return true;
+}
+
+static bool ParseOptions(int argc, char** argv, BenchOptions& options)
+{
+	for (int i = 1; i < argc; i++) {
+		const bool hasValue = i + 1 < argc;
+		if (std::strcmp(argv[i], "--min-molecules") == 0 && hasValue) {
+			options.MinMolecules = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+		}
+		else if (std::strcmp(argv[i], "--max-molecules") == 0 && hasValue) {
+			options.MaxMolecules = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+		}
+		else if (std::strcmp(argv[i], "--max-threads") == 0 && hasValue) {
+			options.MaxThreads = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+		}
+		else if (std::strcmp(argv[i], "--grain") == 0 && hasValue) {
+			options.GrainSize = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+		}
+		else if (std::strcmp(argv[i], "--partition") == 0 && hasValue) {
+			const bool chunks = std::strcmp(argv[++i], "chunks") == 0;
+			if (!chunks && std::strcmp(argv[i], "cost") != 0) {
+				std::cout << "Error ParseOptions: the partition is chunks or cost, not " << argv[i] << std::endl;
+				return false;
+			}
+			options.Partition = chunks ? SPHSolver::WorkPartition::CHUNKS : SPHSolver::WorkPartition::COST;
+		}
+		else if (std::strcmp(argv[i], "--indexing") == 0 && hasValue) {
+			const char* value = argv[++i];
+			if (std::strcmp(value, "hash") == 0) {
+				options.Indexing = SPHSolver::CellIndexing::HASH;
+			}
+			else if (std::strcmp(value, "dense") == 0) {
+				options.Indexing = SPHSolver::CellIndexing::DENSE;
+			}
+			else if (std::strcmp(value, "morton") == 0) {
+				options.Indexing = SPHSolver::CellIndexing::MORTON;
+			}
+			else {
+				std::cout << "Error ParseOptions: the indexing is hash, dense or morton, not " << value << std::endl;
+				return false;
+			}
+		}
+		else if (std::strcmp(argv[i], "--sort") == 0 && hasValue) {
+			const char* value = argv[++i];
+			const auto name = std::find_if(std::begin(SortNames), std::end(SortNames), [value](const char* n) { return std::strcmp(n, value) == 0; });
+			if (name == std::end(SortNames)) {
+				std::cout << "Error ParseOptions: the sort is comparison, counting or incremental, not " << value << std::endl;
+				return false;
+			}
+			options.Sort = (SPHSolver::SortMethod)(name - std::begin(SortNames));
+		}
+		else if (std::strcmp(argv[i], "--output") == 0 && hasValue) {
+			options.Output = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--symmetric") == 0) {
+			options.Symmetric = true;
+		}
+		else if (std::strcmp(argv[i], "--lists") == 0) {
+			options.Lists = true;
+		}
+		else {
+			std::cout << "Error ParseOptions: unknown option " << argv[i] << std::endl;
+			return false;
+		}
+	}
+	if (options.MinMolecules == 0 || options.MaxMolecules < options.MinMolecules || options.MaxThreads == 0) {
+		std::cout << "Error ParseOptions: the molecule and thread counts must be positive and ordered" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	BenchOptions options;
+	if (!ParseOptions(argc, argv, options)) {
+		std::cout << "usage: sphbench [--min-molecules n] [--max-molecules n] [--max-threads n] [--symmetric] [--lists] [--grain n] [--partition chunks|cost] [--indexing hash|dense|morton] [--sort comparison|counting|incremental] [--output file.json]" << std::endl;
+		return 1;
+	}
+
+	// the molecule counts grow by 4, the thread counts double and always end with the maximum
+	std::vector<uint32_t> moleculeCounts;
+	for (uint64_t n = options.MinMolecules; n <= options.MaxMolecules; n *= 4) {
+		moleculeCounts.push_back((uint32_t)n);
+	}
+	std::vector<uint32_t> threadCounts;
+	for (uint32_t t = 1; t < options.MaxThreads; t *= 2) {
+		threadCounts.push_back(t);
+	}
+	threadCounts.push_back(options.MaxThreads);
+
+	std::printf("%10s %8s %18s %10s %10s %12s %10s\n", "molecules", "threads", "check_neighbours", "density", "force", "collisions", "update");
+	std::vector<BenchResult> results;
+	for (uint32_t molecules : moleculeCounts) {
+		for (uint32_t threads : threadCounts) {
+			const BenchResult result = RunBenchmark(molecules, threads, options);
+			const double* ns = result.NanosecondsPerMolecule;
+			std::printf("%10u %8u %18.2f %10.2f %10.2f %12.2f %10.2f\n", molecules, threads, ns[CHECK_NEIGHBOURS], ns[DENSITY], ns[FORCE], ns[COLLISIONS], ns[UPDATE]);
+			std::fflush(stdout);
+			results.push_back(result);
+		}
+	}
+
+	if (!WriteJson(options.Output, options, results)) {
+		return 1;
+	}
+	std::printf("ns/molecule/step written to %s\n", options.Output.c_str());
+	return 0;
+}
@@ -0,0 +1,79 @@
+#include "AllocationCounter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<uint64_t> s_Count = 0;
+static thread_local bool t_Tracked = false;
+
+void AllocationCounter::TrackCurrentThread()
+{
+	t_Tracked = true;
+}
+
+uint64_t AllocationCounter::GetCount()
+{
+	return s_Count.load(std::memory_order_relaxed);
+}
+
+void AllocationCounter::Record()
+{
+	if (t_Tracked) {
+		s_Count.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+#ifdef _DEBUG
+
+static void* Allocate(size_t size)
+{
+	AllocationCounter::Record();
+	void* ptr = std::malloc(size > 0 ? size : 1);
+	if (ptr == nullptr) {
+		throw std::bad_alloc();
+	}
+	return ptr;
+}
+
+static void* AllocateAligned(size_t size, std::align_val_t alignment)
+{
+	AllocationCounter::Record();
+	size_t align = (size_t)alignment;
+	// aligned_alloc wants the size to be a multiple of the alignment
+	size = (size + align - 1) / align * align;
+#ifdef _MSC_VER
+	void* ptr = _aligned_malloc(size > 0 ? size : align, align);
+#else
+	void* ptr = std::aligned_alloc(align, size > 0 ? size : align);
+#endif
+	if (ptr == nullptr) {
+		throw std::bad_alloc();
+	}
+	return ptr;
+}
+
+static void FreeAligned(void* ptr)
+{
+#ifdef _MSC_VER
+	_aligned_free(ptr);
+#else
+	std::free(ptr);
+#endif
+}
+
+void* operator new(size_t size) { return Allocate(size); }
+void* operator new[](size_t size) { return Allocate(size); }
+void* operator new(size_t size, std::align_val_t alignment) { return AllocateAligned(size, alignment); }
+void* operator new[](size_t size, std::align_val_t alignment) { return AllocateAligned(size, alignment); }
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete[](void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::align_val_t) noexcept { FreeAligned(ptr); }
+void operator delete[](void* ptr, std::align_val_t) noexcept { FreeAligned(ptr); }
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept { FreeAligned(ptr); }
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept { FreeAligned(ptr); }
+
+#endif
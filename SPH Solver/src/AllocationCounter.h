@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cinttypes>
+
+// counts the heap allocations made by the threads that opted in
+// the global operator new is only replaced in debug builds, in release the count stays 0
+class AllocationCounter
+{
+public:
+	// start counting the allocations of the calling thread
+	static void TrackCurrentThread();
+	static uint64_t GetCount();
+
+	// called by the replaced operator new
+	static void Record();
+
+private:
+	AllocationCounter() = default;
+
+};
@@ -0,0 +1,96 @@
+#include "CPUFeatures.h"
+
+#include <cstdint>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#include <immintrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+static struct FeatureData
+{
+	bool Detected = false;
+	bool SSE42 = false;
+	bool AVX2 = false;
+	bool AVX512 = false;
+} Fdata;
+
+static void CPUID(uint32_t leaf, uint32_t subleaf, uint32_t regs[4])
+{
+#ifdef _MSC_VER
+	__cpuidex((int*)regs, (int)leaf, (int)subleaf);
+#else
+	__cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+static uint64_t ReadXCR0()
+{
+#ifdef _MSC_VER
+	return _xgetbv(0);
+#else
+	uint32_t eax, edx;
+	__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return ((uint64_t)edx << 32) | eax;
+#endif
+}
+
+void CPUFeatures::Detect()
+{
+	uint32_t regs[4];
+	CPUID(0, 0, regs);
+	const uint32_t maxLeaf = regs[0];
+
+	CPUID(1, 0, regs);
+	Fdata.SSE42 = (regs[2] >> 20) & 1;
+	const bool osxsave = (regs[2] >> 27) & 1;
+	const bool avx = (regs[2] >> 28) & 1;
+	// the avx2 kernels are compiled with -mfma, so the variant also needs fused multiply-add
+	const bool fma = (regs[2] >> 12) & 1;
+
+	// the ymm registers are only usable when the os saves them on a context switch
+	bool ymmState = false;
+	if (osxsave && avx) {
+		ymmState = (ReadXCR0() & 0x6) == 0x6;
+	}
+	// the zmm and mask registers need three more state components
+	bool zmmState = false;
+	if (ymmState) {
+		zmmState = (ReadXCR0() & 0xe6) == 0xe6;
+	}
+	if (ymmState && maxLeaf >= 7) {
+		CPUID(7, 0, regs);
+		Fdata.AVX2 = fma && ((regs[1] >> 5) & 1);
+		// msvc builds the avx-512 kernels with /arch:AVX512, which may also emit CD, BW, DQ and VL instructions
+		const uint32_t avx512 = (1u << 16) | (1u << 17) | (1u << 28) | (1u << 30) | (1u << 31);
+		Fdata.AVX512 = zmmState && (regs[1] & avx512) == avx512;
+	}
+
+	Fdata.Detected = true;
+}
+
+bool CPUFeatures::HasSSE42()
+{
+	if (!Fdata.Detected) {
+		CPUFeatures::Detect();
+	}
+	return Fdata.SSE42;
+}
+
+bool CPUFeatures::HasAVX2()
+{
+	if (!Fdata.Detected) {
+		CPUFeatures::Detect();
+	}
+	return Fdata.AVX2;
+}
+
+bool CPUFeatures::HasAVX512()
+{
+	if (!Fdata.Detected) {
+		CPUFeatures::Detect();
+	}
+	return Fdata.AVX512;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+// instruction sets the processor and the operating system both support, queried once through cpuid
+class CPUFeatures
+{
+public:
+	static bool HasSSE42();
+	static bool HasAVX2();
+	static bool HasAVX512();
+
+private:
+	static void Detect();
+
+};
@@ -1,26 +1,31 @@
 #include "CollisionSolver.h"
 
-#include "Renderer.h"
+#include <cmath>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
-void CollisionSolver::ContainerCollision(SPHSolver::MoleculeProperties& props, float moleculeScale)
+CollisionSolver::ContainerState CollisionSolver::MakeContainerState(const glm::mat4& transform, float rotationDegrees)
 {
-	//ContainerTransform = Renderer::Scene::GetContainerTransform();
-	glm::mat4 ContainerTransform = Renderer::Scene::GetContainerTransform();
-	if (std::fabsf(glm::determinant(ContainerTransform)) < 0.0001f) {
+	CollisionSolver::ContainerState container;
+	container.Transform = transform;
+	container.Degenerate = std::fabs(glm::determinant(container.Transform)) < 0.0001f;
+	container.InverseTransform = container.Degenerate ? glm::mat4(1.0f) : glm::inverse(container.Transform);
+	container.Rotation = glm::mat3(glm::rotate(glm::mat4(1.0f), glm::radians(rotationDegrees), glm::vec3(0.0f, 0.0f, 1.0f)));
+	container.InverseRotation = glm::transpose(container.Rotation);
+	return container;
+}
+
+void CollisionSolver::ContainerCollision(const CollisionSolver::ContainerState& container, glm::vec3& moleculePosition, glm::vec3& moleculeVelocity)
+{
+	if (container.Degenerate) {
 		return;
 	}
-	ContainerTransform = glm::inverse(ContainerTransform);
-	glm::mat4 rotation = glm::rotate(glm::mat4(1.0f), glm::radians(-Renderer::Scene::GetContainerRotation()), glm::vec3(0.0f, 0.0f, 1.0f));
-
-	glm::vec4 position(props.Position.x, props.Position.y, props.Position.z, 1.0f);
-	glm::vec4 velocity(props.Velocity.x, props.Velocity.y, props.Velocity.z, 0.0f);
 
-	velocity = rotation * velocity;
-	position = ContainerTransform * position;
+	// move into the space of the container, where it is the [-0.5, 0.5] cube
+	glm::vec3 position = glm::vec3(container.InverseTransform * glm::vec4(moleculePosition, 1.0f));
+	glm::vec3 velocity = container.InverseRotation * moleculeVelocity;
 
 	float dampness = 0.5f;
 	if (position.y < -0.5f && position.x > -0.6f && position.x < 0.6f
@@ -54,8 +59,6 @@ void CollisionSolver::ContainerCollision(SPHSolver::MoleculeProperties& props, f
 		position.z = 0.5f;
 	}
 
-	ContainerTransform = Renderer::Scene::GetContainerTransform();
-	rotation = glm::rotate(glm::mat4(1.0f), glm::radians(Renderer::Scene::GetContainerRotation()), glm::vec3(0.0f, 0.0f, 1.0f));
-	props.Velocity = rotation * velocity;
-	props.Position = ContainerTransform * position;
+	moleculeVelocity = container.Rotation * velocity;
+	moleculePosition = glm::vec3(container.Transform * glm::vec4(position, 1.0f));
 }
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+class CollisionSolver
+{
+public:
+	// the container matrices, computed once per step instead of once per molecule
+	struct ContainerState
+	{
+		bool Degenerate;  // a flat container does not hold anything
+		glm::mat4 Transform;
+		glm::mat4 InverseTransform;
+		glm::mat3 Rotation;
+		glm::mat3 InverseRotation;
+	};
+
+public:
+	// the container is the unit cube placed by transform, rotated around z by rotationDegrees
+	static CollisionSolver::ContainerState MakeContainerState(const glm::mat4& transform, float rotationDegrees);
+	static void ContainerCollision(const CollisionSolver::ContainerState& container, glm::vec3& moleculePosition, glm::vec3& moleculeVelocity);
+
+private:
+	CollisionSolver() = default;
+
+};
\ No newline at end of file
@@ -0,0 +1,107 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+
+static constexpr uint32_t NumSections = (uint32_t)Profiler::Section::COUNT;
+
+static const char* SectionNames[NumSections] = {
+	"Predict", "Neighbour lists", "Hash", "Sort", "Reorder", "Partition", "Density", "Force", "Collision",
+	"Render", "UI"
+};
+
+static struct ProfilerData
+{
+	uint64_t Current[NumSections] = {};  // the nanoseconds of the frame that is still running
+	float History[NumSections][Profiler::HistoryLength] = {};  // ring buffers, in milliseconds
+	float FrameHistory[Profiler::HistoryLength] = {};
+	uint32_t Next = 0;   // the ring slot of the next frame
+	uint32_t Count = 0;
+	uint64_t FrameStart = 0;
+} Pdata;
+
+static Profiler::Statistics ComputeStatistics(const float* ring)
+{
+	Profiler::Statistics stats = {};
+	if (Pdata.Count == 0) {
+		return stats;
+	}
+	std::array<float, Profiler::HistoryLength> values;
+	for (uint32_t i = 0; i < Pdata.Count; i++) {
+		values[i] = ring[i];
+	}
+	float sum = 0.0f;
+	stats.Min = values[0];
+	for (uint32_t i = 0; i < Pdata.Count; i++) {
+		stats.Min = std::min(stats.Min, values[i]);
+		sum += values[i];
+	}
+	stats.Average = sum / Pdata.Count;
+	stats.Last = ring[(Pdata.Next + Profiler::HistoryLength - 1) % Profiler::HistoryLength];
+
+	// the slowest frame of a full history is above the 99th percentile, the one before it is not
+	const uint32_t rank = (uint32_t)(0.99f * (Pdata.Count - 1));
+	std::nth_element(values.begin(), values.begin() + rank, values.begin() + Pdata.Count);
+	stats.P99 = values[rank];
+	return stats;
+}
+
+uint64_t Profiler::Now()
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Profiler::Add(Profiler::Section section, uint64_t nanoseconds)
+{
+	Pdata.Current[(uint32_t)section] += nanoseconds;
+}
+
+void Profiler::EndFrame()
+{
+	const uint64_t now = Profiler::Now();
+	// the first call only starts the clock, there is no whole frame to record yet
+	if (Pdata.FrameStart != 0) {
+		for (uint32_t s = 0; s < NumSections; s++) {
+			Pdata.History[s][Pdata.Next] = (float)(Pdata.Current[s] * 1.0e-6);
+		}
+		Pdata.FrameHistory[Pdata.Next] = (float)((now - Pdata.FrameStart) * 1.0e-6);
+		Pdata.Next = (Pdata.Next + 1) % Profiler::HistoryLength;
+		Pdata.Count = std::min(Pdata.Count + 1, Profiler::HistoryLength);
+	}
+	std::fill(Pdata.Current, Pdata.Current + NumSections, 0ull);
+	Pdata.FrameStart = now;
+}
+
+const char* Profiler::GetName(Profiler::Section section)
+{
+	return SectionNames[(uint32_t)section];
+}
+
+Profiler::Statistics Profiler::GetStatistics(Profiler::Section section)
+{
+	return ComputeStatistics(Pdata.History[(uint32_t)section]);
+}
+
+Profiler::Statistics Profiler::GetFrameStatistics()
+{
+	return ComputeStatistics(Pdata.FrameHistory);
+}
+
+uint32_t Profiler::GetFrameCount()
+{
+	return Pdata.Count;
+}
+
+float Profiler::GetHistory(Profiler::Section section, uint32_t frame)
+{
+	// until the ring is full the oldest frame sits in slot 0
+	const uint32_t first = Pdata.Count < Profiler::HistoryLength ? 0 : Pdata.Next;
+	return Pdata.History[(uint32_t)section][(first + frame) % Profiler::HistoryLength];
+}
+
+float Profiler::GetFrameHistory(uint32_t frame)
+{
+	const uint32_t first = Pdata.Count < Profiler::HistoryLength ? 0 : Pdata.Next;
+	return Pdata.FrameHistory[(first + frame) % Profiler::HistoryLength];
+}
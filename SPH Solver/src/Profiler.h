@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cinttypes>
+
+#include "Tracer.h"
+
+// adds up the wall time of the sections of a frame, the totals of the last frames are kept for the telemetry window
+// only the thread running the main loop records, the solver phases are timed around their dispatches
+class Profiler
+{
+public:
+	enum class Section
+	{
+		PREDICT, LISTS, HASH, SORT, REORDER, PARTITION, DENSITY, FORCE, COLLISION,  // the solver steps
+		RENDER, UI,                                                                  // the application
+		COUNT
+	};
+
+	// milliseconds per frame over the recorded frames
+	struct Statistics
+	{
+		float Last;
+		float Min;
+		float Average;
+		float P99;
+	};
+
+	static constexpr uint32_t HistoryLength = 240;
+
+public:
+	static uint64_t Now();  // in nanoseconds
+	static void Add(Profiler::Section section, uint64_t nanoseconds);
+	// closes the current frame and starts the next one, the frame time is measured between two calls
+	static void EndFrame();
+
+	static const char* GetName(Profiler::Section section);
+	static Profiler::Statistics GetStatistics(Profiler::Section section);
+	static Profiler::Statistics GetFrameStatistics();
+	// the recorded frames, 0 is the oldest, fewer than HistoryLength right after the start
+	static uint32_t GetFrameCount();
+	static float GetHistory(Profiler::Section section, uint32_t frame);
+	static float GetFrameHistory(uint32_t frame);
+
+private:
+	Profiler() = default;
+
+};
+
+// adds the time between its construction and its destruction to a section, and records it as a slice of the trace
+class ProfileScope
+{
+public:
+	ProfileScope(Profiler::Section section)
+		: m_Section(section), m_Start(Profiler::Now()) {}
+	~ProfileScope()
+	{
+		const uint64_t end = Profiler::Now();
+		Profiler::Add(m_Section, end - m_Start);
+		Tracer::Record(Profiler::GetName(m_Section), m_Start, end);
+	}
+
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+	Profiler::Section m_Section;
+	uint64_t m_Start;
+
+};
@@ -1,5 +1,6 @@
 #include "Random.h"
 
+#include <cmath>
 #include <random>
 
 static std::mt19937 s_Engine;
@@ -9,6 +10,11 @@ void Random::Init()
 	s_Engine.seed(std::random_device()());
 }
 
+void Random::Seed(uint32_t seed)
+{
+	s_Engine.seed(seed);
+}
+
 float Random::GetFloat(float min, float max)
 {
 	// way faster than uniform_real_distribution
@@ -26,8 +32,8 @@ glm::vec2 Random::GetPointOnCenterDisk(float radius)
 	// avoids points clustering around the corners of the circumscribed square
 	theta = Random::GetFloat(0.0f, glm::two_pi<float>());
 	scale = Random::GetFloat(0.0f, radius);
-	result.x = scale * std::cosf(theta);
-	result.y = scale * std::sinf(theta);
+	result.x = scale * std::cos(theta);
+	result.y = scale * std::sin(theta);
 	return result;
 }
 
@@ -8,6 +8,8 @@ class Random
 {
 public:
 	static void Init();
+	// a fixed seed makes the starting distribution of the molecules repeatable
+	static void Seed(uint32_t seed);
 	
 	static float GetFloat(float min = 0.0f, float max = 1.0f);
 	static glm::vec2 GetPointOnCenterDisk(float radius = 1.0f);
@@ -0,0 +1,1309 @@
+#include "SPHSolver.h"
+
+#include "Random.h"
+#include "CollisionSolver.h"
+#include "ThreadPool.h"
+#include "AllocationCounter.h"
+#include "SolverKernels.h"
+#include "Profiler.h"
+#include "Tracer.h"
+
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cfloat>
+#include <thread>
+
+static SPHSolver::MoleculesData Mdata;
+static Scope<ThreadPool> s_Pool;  // the workers persist between steps and park when idle
+static SPHSolver::GridStatistics s_Statistics;
+static bool s_CollectStatistics = false;
+static SolverKernels::Constants s_Constants;  // refreshed at the start of every step
+static SolverKernels::CellKeyParams s_KeyParams;  // refreshed every time the lookup is rebuilt
+static CollisionSolver::ContainerState s_Container;  // refreshed at the start of every step
+
+// above this many cells the dense grid costs more memory than it saves, so hashing is used
+static constexpr uint64_t MaxDenseCells = 1 << 22;
+// above this fraction of molecules changing cell the incremental sort costs more than a counting sort
+static constexpr float MaxChangedFraction = 0.1f;
+
+void SPHSolver::ResetMolecules(const SPHSolver::SimulationConfig& config)
+{
+	// get the position and scale of the starting box
+	glm::vec3 boxPos = config.StartingBoxPosition;
+	glm::vec3 scale = config.StartingBoxScale;
+	// compute the coordinates of the top-left corner of the box
+	// used to randomly set the molecule's position within bounds
+	glm::vec3 topLeft;
+	topLeft.x = boxPos.x - scale.x * 0.5f;
+	topLeft.y = boxPos.y + scale.y * 0.5f;
+	SPHSolver::MoleculeProperties& props = *Mdata.Properties;
+	for (uint32_t i = 0; i < Mdata.NumMolecules; i++) {
+		props.SetVelocity(i, glm::vec3(0.0f));
+		props.PositionX[i] = Random::GetFloat(topLeft.x, topLeft.x + scale.x);
+		props.PositionY[i] = Random::GetFloat(topLeft.y - scale.y, topLeft.y);
+		//props.PositionZ[i] = Random::GetFloat(topLeft.y - scale.y, topLeft.y);
+		props.PositionZ[i] = 0.0f;
+	}
+	// the molecules teleported, the cached neighbour lists are meaningless now
+	Mdata.ListsValid = false;
+}
+
+void SPHSolver::MoleculeProperties::Resize(size_t count)
+{
+	PositionX.resize(count);
+	PositionY.resize(count);
+	PositionZ.resize(count);
+	PredictedX.resize(count);
+	PredictedY.resize(count);
+	PredictedZ.resize(count);
+	VelocityX.resize(count);
+	VelocityY.resize(count);
+	VelocityZ.resize(count);
+	Density.resize(count);
+	NearDensity.resize(count);
+	Pressure.resize(count);
+	NearPressure.resize(count);
+}
+
+glm::ivec3 SPHSolver::GetGridPosition(const glm::vec3& pos)
+{
+	// snap the real position to the grid
+	glm::ivec3 result;
+	result.x = (int)(std::floor(pos.x / Mdata.CellSize));
+	result.y = (int)(std::floor(pos.y / Mdata.CellSize));
+	//result.z = (int)(std::floor(pos.z / Mdata.CellSize));
+	result.z = 0.0f;
+	return result;
+}
+
+uint32_t SPHSolver::GetHashCodeFromGrid(const glm::ivec3& gridPos)
+{
+	uint32_t hashCode = (uint32_t)((gridPos.x * 73856093) ^ (gridPos.y * 19349663) ^ (gridPos.z * 8349279)) % (Mdata.NumMolecules);
+	return hashCode;
+}
+
+uint32_t SPHSolver::GetDenseIndexFromGrid(const glm::ivec3& gridPos)
+{
+	glm::ivec3 local = gridPos - Mdata.GridOrigin;
+	// cells outside of the grid share the last slot, which never holds any molecule
+	if (local.x < 0 || local.y < 0 || local.z < 0
+		|| local.x >= Mdata.GridSize.x || local.y >= Mdata.GridSize.y || local.z >= Mdata.GridSize.z) {
+		return Mdata.TableSize - 1;
+	}
+	return (uint32_t)((local.z * Mdata.GridSize.y + local.y) * Mdata.GridSize.x + local.x);
+}
+
+uint32_t SPHSolver::GetCellKey(const glm::ivec3& gridPos)
+{
+	if (Mdata.ActiveIndexing == SPHSolver::CellIndexing::DENSE) {
+		return SPHSolver::GetDenseIndexFromGrid(gridPos);
+	}
+	if (Mdata.ActiveIndexing == SPHSolver::CellIndexing::MORTON) {
+		const uint32_t index = SPHSolver::GetDenseIndexFromGrid(gridPos);
+		return index == Mdata.TableSize - 1 ? index : Mdata.MortonSlots[index];
+	}
+	return SPHSolver::GetHashCodeFromGrid(gridPos);
+}
+
+// spreads the low 21 bits of v so two zero bits follow each of them
+static uint64_t SpreadBits(uint64_t v)
+{
+	v &= 0x1fffff;
+	v = (v | v << 32) & 0x001f00000000ffffull;
+	v = (v | v << 16) & 0x001f0000ff0000ffull;
+	v = (v | v << 8) & 0x100f00f00f00f00full;
+	v = (v | v << 4) & 0x10c30c30c30c30c3ull;
+	v = (v | v << 2) & 0x1249249249249249ull;
+	return v;
+}
+
+void SPHSolver::NumberMortonSlots()
+{
+	// the slots only depend on the size of the grid, so moving the container keeps them
+	if (Mdata.MortonGridSize == Mdata.GridSize && !Mdata.MortonSlots.empty()) {
+		return;
+	}
+	const glm::ivec3 size = Mdata.GridSize;
+	const uint32_t cells = (uint32_t)size.x * size.y * size.z;
+
+	// sort the cells by the interleaved bits of their local coordinates, the rank is the slot
+	std::vector<std::pair<uint64_t, uint32_t>> codes(cells);
+	for (int z = 0; z < size.z; z++) {
+		for (int y = 0; y < size.y; y++) {
+			for (int x = 0; x < size.x; x++) {
+				const uint32_t index = (uint32_t)((z * size.y + y) * size.x + x);
+				codes[index] = { SpreadBits(x) | SpreadBits(y) << 1 | SpreadBits(z) << 2, index };
+			}
+		}
+	}
+	std::sort(codes.begin(), codes.end());
+	Mdata.MortonSlots.resize(cells);
+	for (uint32_t slot = 0; slot < cells; slot++) {
+		Mdata.MortonSlots[codes[slot].second] = slot;
+	}
+	Mdata.MortonGridSize = size;
+	Mdata.BuffersResized = true;
+}
+
+const SPHSolver::NeighbourRanges& SPHSolver::GetNeighbourRanges(const glm::ivec3& gridPos)
+{
+	// molecules of the same cell share the result, the last one is cached per worker
+	SPHSolver::NeighbourRanges& ranges = Mdata.NeighbourCache[ThreadPool::GetWorkerIndex()];
+	if (ranges.Stamp == Mdata.Stamp && ranges.Cell == gridPos) {
+		return ranges;
+	}
+	ranges.Cell = gridPos;
+	ranges.Stamp = Mdata.Stamp;
+	ranges.Count = 0;
+
+	// several cells of the 3x3 block can land in the same bucket,
+	// each bucket must only be visited once or its molecules are counted twice
+	uint32_t codes[9];
+	for (uint32_t k = 0; k < 9; k++) {
+		uint32_t code = SPHSolver::GetCellKey(gridPos + Mdata.Offsets[k]);
+		if (Mdata.StartIndices[code] == UINT32_MAX) {
+			continue;
+		}
+		bool duplicate = false;
+		for (uint32_t n = 0; n < ranges.Count; n++) {
+			duplicate |= codes[n] == code;
+		}
+		if (duplicate) {
+			continue;
+		}
+		codes[ranges.Count] = code;
+		ranges.Begin[ranges.Count] = Mdata.StartIndices[code];
+		ranges.End[ranges.Count] = Mdata.EndIndices[code];
+		ranges.Count++;
+	}
+	return ranges;
+}
+
+// calls visit(j) for every molecule j != i that may lie within the influence radius of molecule i
+template <typename Visitor>
+static inline void ForEachNeighbour(uint32_t i, const glm::vec3& position, Visitor&& visit)
+{
+	if (Mdata.ListsActive) {
+		// the cached list already excludes the molecule itself
+		for (uint32_t n = Mdata.ListStart[i]; n < Mdata.ListStart[i + 1]; n++) {
+			visit(Mdata.ListNeighbours[n]);
+		}
+		return;
+	}
+
+	// go through the distinct buckets of the 3x3 grid
+	const SPHSolver::NeighbourRanges& ranges = SPHSolver::GetNeighbourRanges(SPHSolver::GetGridPosition(position));
+	for (uint32_t k = 0; k < ranges.Count; k++) {
+		for (uint32_t j = ranges.Begin[k]; j < ranges.End[k]; j++) {
+			// a particle should not influence itself
+			if (j != i) {
+				visit(j);
+			}
+		}
+	}
+}
+
+// the own cell first, then the 4 forward neighbours of the 3x3 block (indices into the offsets),
+// the other 4 neighbours see this cell as one of their forward ones
+static const uint32_t HalfStencil[5] = { 4, 5, 2, 1, 0 };
+
+// calls visit(j) for every molecule j that may lie within the influence radius of molecule i,
+// each unordered pair is visited from only one of its two molecules
+template <typename Visitor>
+static inline void ForEachPair(uint32_t i, const glm::vec3& position, Visitor&& visit)
+{
+	if (Mdata.ListsActive) {
+		// the cached lists only hold each pair once in this mode
+		for (uint32_t n = Mdata.ListStart[i]; n < Mdata.ListStart[i + 1]; n++) {
+			visit(Mdata.ListNeighbours[n]);
+		}
+		return;
+	}
+
+	// a hash bucket can hold molecules of other cells, so those have to be filtered by their actual cell
+	const SPHSolver::MoleculeProperties& props = *Mdata.Properties;
+	const bool filter = Mdata.ActiveIndexing == SPHSolver::CellIndexing::HASH;
+	const glm::ivec3 cell = SPHSolver::GetGridPosition(position);
+	for (uint32_t k = 0; k < 5; k++) {
+		const glm::ivec3 target = cell + Mdata.Offsets[HalfStencil[k]];
+		const uint32_t code = SPHSolver::GetCellKey(target);
+		if (Mdata.StartIndices[code] == UINT32_MAX) {
+			continue;
+		}
+		// inside its own cell, a molecule only pairs with the ones stored after it
+		const uint32_t begin = k == 0 ? i + 1 : Mdata.StartIndices[code];
+		for (uint32_t j = begin; j < Mdata.EndIndices[code]; j++) {
+			if (filter && SPHSolver::GetGridPosition(props.GetPredictedPosition(j)) != target) {
+				continue;
+			}
+			visit(j);
+		}
+	}
+}
+
+// the pair passes cost about as much as the neighbours they visit, so they take the cost partition when it is on
+template <typename Func>
+static inline void ForEachMoleculeByCost(Func&& body, const char* name)
+{
+	if (Mdata.Partition == SPHSolver::WorkPartition::COST) {
+		s_Pool->ParallelRanges(Mdata.WorkBounds.data(), body, name);
+	}
+	else {
+		s_Pool->ParallelFor(Mdata.NumMolecules, body, name);
+	}
+}
+
+bool SPHSolver::NeighbourListsExpired()
+{
+	ProfileScope scope(Profiler::Section::LISTS);
+	if (!Mdata.ListsValid || Mdata.ListRadius != Mdata.h + Mdata.Skin || Mdata.ListsHalf != Mdata.Symmetric) {
+		return true;
+	}
+
+	// the lists hold every pair within h as long as no molecule moved more than half the skin
+	const float limit = 0.25f * Mdata.Skin * Mdata.Skin;
+	std::atomic<bool> expired = false;
+	const SPHSolver::MoleculeProperties& props = *Mdata.Properties;
+	s_Pool->ParallelFor(Mdata.NumMolecules, [&expired, &props, limit](uint32_t i) {
+		float dx = props.PredictedX[i] - Mdata.ListX[i];
+		float dy = props.PredictedY[i] - Mdata.ListY[i];
+		float dz = props.PredictedZ[i] - Mdata.ListZ[i];
+		if (dx * dx + dy * dy + dz * dz > limit) {
+			expired.store(true, std::memory_order_relaxed);
+		}
+	}, "List check");
+	return expired.load();
+}
+
+void SPHSolver::BuildNeighbourLists()
+{
+	ProfileScope scope(Profiler::Section::LISTS);
+	// the grid cells are h + skin wide here, so the 3x3 block covers the whole list radius
+	const uint32_t numMolecules = Mdata.NumMolecules;
+	const float radius = Mdata.h + Mdata.Skin;
+	const float radiusSq = radius * radius;
+	const SPHSolver::MoleculeProperties& props = *Mdata.Properties;
+
+	// the symmetric passes need every pair once, the others need both directions
+	auto candidates = [](uint32_t i, const glm::vec3& position, auto&& visit) {
+		if (Mdata.Symmetric) {
+			ForEachPair(i, position, visit);
+		}
+		else {
+			ForEachNeighbour(i, position, visit);
+		}
+	};
+
+	// count the neighbours of every molecule and remember where it was
+	s_Pool->ParallelFor(numMolecules, [&props, &candidates, radiusSq](uint32_t i) {
+		const glm::vec3 position = props.GetPredictedPosition(i);
+		uint32_t count = 0;
+		candidates(i, position, [&props, &position, &count, radiusSq](uint32_t j) {
+			glm::vec3 difference = position - props.GetPredictedPosition(j);
+			count += glm::dot(difference, difference) <= radiusSq;
+		});
+		Mdata.ListStart[i + 1] = count;
+		Mdata.ListX[i] = position.x;
+		Mdata.ListY[i] = position.y;
+		Mdata.ListZ[i] = position.z;
+	}, "List count");
+
+	Mdata.ListStart[0] = 0;
+	for (uint32_t i = 0; i < numMolecules; i++) {
+		Mdata.ListStart[i + 1] += Mdata.ListStart[i];
+	}
+	const uint32_t total = Mdata.ListStart[numMolecules];
+	if (total > Mdata.ListNeighbours.size()) {
+		Mdata.ListNeighbours.resize(total + total / 4);
+		Mdata.BuffersResized = true;
+	}
+
+	// then fill the lists
+	s_Pool->ParallelFor(numMolecules, [&props, &candidates, radiusSq](uint32_t i) {
+		const glm::vec3 position = props.GetPredictedPosition(i);
+		uint32_t* list = &Mdata.ListNeighbours[Mdata.ListStart[i]];
+		candidates(i, position, [&props, &position, &list, radiusSq](uint32_t j) {
+			glm::vec3 difference = position - props.GetPredictedPosition(j);
+			if (glm::dot(difference, difference) <= radiusSq) {
+				*list++ = j;
+			}
+		});
+	}, "List fill");
+
+	Mdata.ListsValid = true;
+	Mdata.ListsHalf = Mdata.Symmetric;
+	Mdata.ListRadius = radius;
+	Mdata.ListRebuilds++;
+}
+
+void SPHSolver::UpdateCellIndexing()
+{
+	const uint32_t numMolecules = Mdata.NumMolecules;
+	Mdata.ActiveIndexing = SPHSolver::CellIndexing::HASH;
+	uint32_t tableSize = numMolecules;
+
+	// a degenerate container does not hold the fluid, so the domain is unbounded
+	const glm::mat4& container = s_Container.Transform;
+	if (Mdata.Indexing != SPHSolver::CellIndexing::HASH && !s_Container.Degenerate) {
+		// the world space bounding box of the (possibly rotated) container
+		glm::vec3 lower(FLT_MAX), upper(-FLT_MAX);
+		for (int c = 0; c < 8; c++) {
+			glm::vec4 corner((c & 1) ? 0.5f : -0.5f, (c & 2) ? 0.5f : -0.5f, (c & 4) ? 0.5f : -0.5f, 1.0f);
+			glm::vec3 world = container * corner;
+			lower = glm::min(lower, world);
+			upper = glm::max(upper, world);
+		}
+
+		// one extra cell on each side keeps the 3x3 block of the border cells inside the grid
+		glm::ivec3 margin(1, 1, 0);
+		glm::ivec3 origin = SPHSolver::GetGridPosition(lower) - margin;
+		glm::ivec3 size = SPHSolver::GetGridPosition(upper) + margin + glm::ivec3(1) - origin;
+		uint64_t cells = (uint64_t)size.x * size.y * size.z;
+
+		if (cells < MaxDenseCells) {
+			Mdata.GridOrigin = origin;
+			Mdata.GridSize = size;
+
+			// molecules that left the grid, e.g. while the container is dragged, force hashing for this step
+			std::atomic<bool> outside = false;
+			const SPHSolver::MoleculeProperties& props = *Mdata.Properties;
+			s_Pool->ParallelFor(numMolecules, [&outside, &props](uint32_t i) {
+				glm::ivec3 local = SPHSolver::GetGridPosition(props.GetPredictedPosition(i)) - Mdata.GridOrigin;
+				if (local.x < 0 || local.y < 0 || local.x >= Mdata.GridSize.x || local.y >= Mdata.GridSize.y) {
+					outside.store(true, std::memory_order_relaxed);
+				}
+			}, "Grid bounds");
+
+			if (!outside.load()) {
+				Mdata.ActiveIndexing = Mdata.Indexing;
+				tableSize = (uint32_t)cells + 1;
+				if (Mdata.ActiveIndexing == SPHSolver::CellIndexing::MORTON) {
+					SPHSolver::NumberMortonSlots();
+				}
+			}
+		}
+	}
+
+	Mdata.TableSize = tableSize;
+	// the tables only grow when the container or the influence radius change
+	if (tableSize > Mdata.StartIndices.size()) {
+		Mdata.StartIndices.resize(tableSize);
+		Mdata.EndIndices.resize(tableSize);
+		Mdata.Histograms.resize((size_t)tableSize * s_Pool->GetNumThreads());
+		Mdata.BuffersResized = true;
+	}
+}
+
+void SPHSolver::CheckNeighbours()
+{
+	// invalidates the neighbour ranges cached during the previous step
+	Mdata.Stamp++;
+
+	// choose between the dense grid and the spatial hash for this step
+	{
+		ProfileScope scope(Profiler::Section::HASH);
+		SPHSolver::UpdateCellIndexing();
+		s_KeyParams.CellSize = Mdata.CellSize;
+		s_KeyParams.Dense = Mdata.ActiveIndexing != SPHSolver::CellIndexing::HASH;
+		s_KeyParams.GridOrigin = Mdata.GridOrigin;
+		s_KeyParams.GridSize = Mdata.GridSize;
+		s_KeyParams.OutsideSlot = Mdata.TableSize - 1;
+		s_KeyParams.HashSize = Mdata.NumMolecules;
+		SPHSolver::ComputeCellKeys();
+	}
+
+	// sort the lookup array based on the hash value, filling in the range of each hash code
+	bool reordered = true;
+	{
+		ProfileScope scope(Profiler::Section::SORT);
+		if (Mdata.Sort == SPHSolver::SortMethod::INCREMENTAL) {
+			reordered = SPHSolver::SortIncrementally();
+		}
+		else if (Mdata.Sort == SPHSolver::SortMethod::COUNTING) {
+			SPHSolver::SortByCounting();
+		}
+		else {
+			SPHSolver::SortByComparison();
+		}
+		Mdata.SortedTableSize = Mdata.TableSize;
+	}
+
+	// swap the ordering in Mdata::properties to match the ordering in the spatial lookup
+	// for better cache hit rate
+	// the molecules are gathered into the back buffer and the buffers are swapped,
+	// so no copy of the front buffer is needed
+	// when no molecule changed cell the order already matches
+	if (reordered) {
+		ProfileScope scope(Profiler::Section::REORDER);
+		const SPHSolver::MoleculeProperties& front = *Mdata.Properties;
+		SPHSolver::MoleculeProperties& back = *Mdata.BackProperties;
+		s_Pool->ParallelFor(Mdata.NumMolecules, [&front, &back](uint32_t i) {
+			const uint32_t source = Mdata.SpatialLookup[i].Index;
+			back.PositionX[i] = front.PositionX[source];
+			back.PositionY[i] = front.PositionY[source];
+			back.PositionZ[i] = front.PositionZ[source];
+			back.PredictedX[i] = front.PredictedX[source];
+			back.PredictedY[i] = front.PredictedY[source];
+			back.PredictedZ[i] = front.PredictedZ[source];
+			back.VelocityX[i] = front.VelocityX[source];
+			back.VelocityY[i] = front.VelocityY[source];
+			back.VelocityZ[i] = front.VelocityZ[source];
+			// density and pressure are recomputed every step, so their order does not matter
+			Mdata.SpatialLookup[i].Index = i;
+		}, "Reorder slice");
+		std::swap(Mdata.Properties, Mdata.BackProperties);
+	}
+
+	if (s_CollectStatistics) {
+		SPHSolver::CollectGridStatistics();
+	}
+}
+
+void SPHSolver::CollectGridStatistics()
+{
+	const uint32_t numMolecules = Mdata.NumMolecules;
+	const SPHSolver::MoleculeProperties& props = *Mdata.Properties;
+	SPHSolver::GridStatistics stats = {};
+	stats.DenseGrid = Mdata.ActiveIndexing != SPHSolver::CellIndexing::HASH;
+	stats.GridSize = Mdata.GridSize;
+	stats.TableSize = Mdata.TableSize;
+
+	// a bucket collides when it holds molecules from more than one cell
+	for (uint32_t code = 0; code < Mdata.TableSize; code++) {
+		if (Mdata.StartIndices[code] == UINT32_MAX) {
+			continue;
+		}
+		stats.OccupiedBuckets++;
+		glm::ivec3 first = SPHSolver::GetGridPosition(props.GetPredictedPosition(Mdata.StartIndices[code]));
+		for (uint32_t j = Mdata.StartIndices[code] + 1; j < Mdata.EndIndices[code]; j++) {
+			if (SPHSolver::GetGridPosition(props.GetPredictedPosition(j)) != first) {
+				stats.CollidingBuckets++;
+				break;
+			}
+		}
+	}
+
+	// a candidate is false when the neighbour loops visit it although it lies outside the 3x3 block
+	for (uint32_t i = 0; i < numMolecules; i++) {
+		glm::ivec3 gridPos = SPHSolver::GetGridPosition(props.GetPredictedPosition(i));
+		const SPHSolver::NeighbourRanges& ranges = SPHSolver::GetNeighbourRanges(gridPos);
+		for (uint32_t k = 0; k < ranges.Count; k++) {
+			for (uint32_t j = ranges.Begin[k]; j < ranges.End[k]; j++) {
+				glm::ivec3 distance = glm::abs(SPHSolver::GetGridPosition(props.GetPredictedPosition(j)) - gridPos);
+				stats.Candidates++;
+				if (distance.x > 1 || distance.y > 1 || distance.z > 1) {
+					stats.FalseCandidates++;
+				}
+			}
+		}
+	}
+
+	s_Statistics = stats;
+}
+
+void SPHSolver::SortByComparison()
+{
+	// add the all the molecules' hash and index in an array
+	for (uint32_t i = 0; i < Mdata.NumMolecules; i++) {
+		Mdata.SpatialLookup[i].Hash = Mdata.CellKeys[i];
+		Mdata.SpatialLookup[i].Index = i;
+	}
+	std::fill(Mdata.StartIndices.begin(), Mdata.StartIndices.begin() + Mdata.TableSize, UINT32_MAX);
+	std::fill(Mdata.EndIndices.begin(), Mdata.EndIndices.begin() + Mdata.TableSize, UINT32_MAX);
+
+	// sort the array based on the hash value
+	std::sort(Mdata.SpatialLookup.begin(), Mdata.SpatialLookup.end(), 
+		[](const SPHSolver::SpatialLookupStruct& a, const SPHSolver::SpatialLookupStruct& b) {
+			return a.Hash < b.Hash;
+		});
+
+	// fill in the start and end indices of each hash code
+	Mdata.StartIndices[Mdata.SpatialLookup[0].Hash] = 0;
+	for (uint32_t i = 1; i < Mdata.NumMolecules; i++) {
+		if (Mdata.SpatialLookup[i].Hash != Mdata.SpatialLookup[i - 1].Hash) {
+			Mdata.StartIndices[Mdata.SpatialLookup[i].Hash] = i;
+			Mdata.EndIndices[Mdata.SpatialLookup[i - 1].Hash] = i;
+		}
+	}
+	Mdata.EndIndices[Mdata.SpatialLookup[Mdata.NumMolecules - 1].Hash] = Mdata.NumMolecules;
+}
+
+void SPHSolver::SortByCounting()
+{
+	// hash codes are bounded by the table size, so the lookup can be binned in linear time
+	// every worker counts the codes of its own block, the histograms are turned into
+	// scatter offsets with a parallel prefix sum and finally each block scatters its entries
+	const uint32_t numMolecules = Mdata.NumMolecules;
+	const uint32_t tableSize = Mdata.TableSize;
+	const uint32_t numWorkers = s_Pool->GetNumThreads();
+
+	s_Pool->Dispatch([numMolecules, tableSize, numWorkers](uint32_t worker) {
+		uint32_t* histogram = &Mdata.Histograms[(size_t)worker * tableSize];
+
+		// 1. count the codes of the worker's block
+		const uint32_t begin = (uint32_t)((uint64_t)numMolecules * worker / numWorkers);
+		const uint32_t end = (uint32_t)((uint64_t)numMolecules * (worker + 1) / numWorkers);
+		std::fill(histogram, histogram + tableSize, 0u);
+		for (uint32_t i = begin; i < end; i++) {
+			uint32_t hash = Mdata.CellKeys[i];
+			Mdata.SortScratch[i] = { i, hash };
+			histogram[hash]++;
+		}
+		s_Pool->Barrier();
+
+		// 2. prefix sum over the codes, each worker handles a range of codes
+		// first the total count of every range, then the offsets inside the range
+		const uint32_t codeBegin = (uint32_t)((uint64_t)tableSize * worker / numWorkers);
+		const uint32_t codeEnd = (uint32_t)((uint64_t)tableSize * (worker + 1) / numWorkers);
+		uint32_t rangeTotal = 0;
+		for (uint32_t code = codeBegin; code < codeEnd; code++) {
+			for (uint32_t w = 0; w < numWorkers; w++) {
+				rangeTotal += Mdata.Histograms[(size_t)w * tableSize + code];
+			}
+		}
+		Mdata.RangeTotals[worker] = rangeTotal;
+		s_Pool->Barrier();
+
+		uint32_t offset = 0;
+		for (uint32_t w = 0; w < worker; w++) {
+			offset += Mdata.RangeTotals[w];
+		}
+		for (uint32_t code = codeBegin; code < codeEnd; code++) {
+			const uint32_t start = offset;
+			// the entries of lower workers come first, which keeps the sort stable
+			for (uint32_t w = 0; w < numWorkers; w++) {
+				uint32_t& count = Mdata.Histograms[(size_t)w * tableSize + code];
+				uint32_t binSize = count;
+				count = offset;
+				offset += binSize;
+			}
+			// the start indices fall out of the prefix sum for free
+			Mdata.StartIndices[code] = offset != start ? start : UINT32_MAX;
+			Mdata.EndIndices[code] = offset != start ? offset : UINT32_MAX;
+		}
+		s_Pool->Barrier();
+
+		// 3. scatter the worker's block to its final position
+		for (uint32_t i = begin; i < end; i++) {
+			const SPHSolver::SpatialLookupStruct& entry = Mdata.SortScratch[i];
+			Mdata.SpatialLookup[histogram[entry.Hash]++] = entry;
+		}
+	}, "Counting sort");
+}
+
+bool SPHSolver::SortIncrementally()
+{
+	// between two steps only the molecules near a cell border change cell, so the lookup
+	// of the last step is nearly sorted: its unchanged entries keep their order, and only
+	// the changed ones are sorted and merged back in
+	// ordering by code and then index gives exactly the order of the stable counting sort
+	// returns false when no molecule changed cell and the lookup is left as it was
+	const uint32_t numMolecules = Mdata.NumMolecules;
+	const uint32_t numWorkers = s_Pool->GetNumThreads();
+	const uint32_t maxChanged = (uint32_t)(numMolecules * MaxChangedFraction);
+
+	// only the buckets of the last sort get cleared, the rest of another table may hold stale ranges
+	if (Mdata.SortedTableSize != Mdata.TableSize) {
+		Mdata.ChangedFraction = 1.0f;
+		SPHSolver::SortByCounting();
+		return true;
+	}
+
+	s_Pool->Dispatch([numMolecules, numWorkers, maxChanged](uint32_t worker) {
+		// 1. count the molecules of the worker's block whose code differs from the sorted one
+		const uint32_t begin = (uint32_t)((uint64_t)numMolecules * worker / numWorkers);
+		const uint32_t end = (uint32_t)((uint64_t)numMolecules * (worker + 1) / numWorkers);
+		uint32_t changed = 0;
+		for (uint32_t i = begin; i < end; i++) {
+			changed += Mdata.CellKeys[i] != Mdata.SpatialLookup[i].Hash;
+		}
+		Mdata.ChangedCounts[worker] = changed;
+		s_Pool->Barrier();
+
+		// every worker comes to the same total, so they all skip together
+		uint32_t total = 0;
+		uint32_t offset = 0;
+		for (uint32_t w = 0; w < numWorkers; w++) {
+			total += Mdata.ChangedCounts[w];
+			offset += w < worker ? Mdata.ChangedCounts[w] : 0;
+		}
+		if (total == 0 || total > maxChanged) {
+			return;
+		}
+
+		// 2. compact the changed entries and clear the buckets that start in the block
+		for (uint32_t i = begin; i < end; i++) {
+			const uint32_t hash = Mdata.CellKeys[i];
+			const uint32_t previous = Mdata.SpatialLookup[i].Hash;
+			if (hash != previous) {
+				Mdata.ChangedEntries[offset++] = { i, hash };
+			}
+			if (i == 0 || previous != Mdata.SpatialLookup[i - 1].Hash) {
+				Mdata.StartIndices[previous] = UINT32_MAX;
+				Mdata.EndIndices[previous] = UINT32_MAX;
+			}
+		}
+	}, "Changed cells");
+
+	uint32_t numChanged = 0;
+	for (uint32_t w = 0; w < numWorkers; w++) {
+		numChanged += Mdata.ChangedCounts[w];
+	}
+	Mdata.ChangedFraction = (float)numChanged / numMolecules;
+	if (numChanged == 0) {
+		return false;
+	}
+	if (numChanged > maxChanged) {
+		SPHSolver::SortByCounting();
+		return true;
+	}
+
+	// 3. sort the few changed entries and merge them with the unchanged ones, which are in order
+	SPHSolver::SpatialLookupStruct* changed = Mdata.ChangedEntries.data();
+	auto less = [](const SPHSolver::SpatialLookupStruct& a, const SPHSolver::SpatialLookupStruct& b) {
+		return a.Hash < b.Hash || (a.Hash == b.Hash && a.Index < b.Index);
+	};
+	std::sort(changed, changed + numChanged, less);
+	uint32_t next = 0;
+	uint32_t out = 0;
+	for (uint32_t i = 0; i < numMolecules; i++) {
+		const SPHSolver::SpatialLookupStruct entry = { i, Mdata.CellKeys[i] };
+		if (entry.Hash != Mdata.SpatialLookup[i].Hash) {
+			continue;
+		}
+		while (next < numChanged && less(changed[next], entry)) {
+			Mdata.SortScratch[out++] = changed[next++];
+		}
+		Mdata.SortScratch[out++] = entry;
+	}
+	while (next < numChanged) {
+		Mdata.SortScratch[out++] = changed[next++];
+	}
+	std::swap(Mdata.SpatialLookup, Mdata.SortScratch);
+
+	// 4. the first and last entry of every run set the range of its code
+	s_Pool->ParallelFor(numMolecules, [](uint32_t i) {
+		const uint32_t hash = Mdata.SpatialLookup[i].Hash;
+		if (i == 0 || hash != Mdata.SpatialLookup[i - 1].Hash) {
+			Mdata.StartIndices[hash] = i;
+		}
+		if (i == Mdata.NumMolecules - 1 || hash != Mdata.SpatialLookup[i + 1].Hash) {
+			Mdata.EndIndices[hash] = i + 1;
+		}
+	}, "Bucket ranges");
+	return true;
+}
+
+// spiky kernel function
+float SPHSolver::Kernel(float distance, float radius)
+{
+	if (distance < 0.0f || distance > radius) {
+		return 0.0f;
+	}
+
+	float scale = 4.774648f / std::pow(radius, 6.0f);  // 15/(pi * h^6)
+	float difference = radius - distance;
+
+	return scale * difference * difference * difference;
+}
+
+float SPHSolver::KernelDerivative(float distance, float radius)
+{
+	if (distance < 0.0f || distance > radius) {
+		return 0.0f;
+	}
+
+	float scale = 4.774648f / std::pow(radius, 6.0f);  // 15/(pi * h^6)
+	float difference = radius - distance;
+
+	return -3.0f * scale * difference * difference;
+}
+
+float SPHSolver::ViscosityKernelLaplacian(float distance, float radius)
+{
+	if (distance < 0.0f || distance > radius) {
+		return 0.0f;
+	}
+
+	float radius3 = std::pow(radius, 3.0f);
+	float scale = 2.387324f / radius3;  // 15/(2pi * h^3)
+	float sum = -3.0f * distance / radius3 + 2.0f / (radius * radius) + radius / (distance * distance * distance);
+	return scale * sum;
+}
+
+float SPHSolver::NearDensityKernel(float distance, float radius)
+{
+	if (distance < 0.0f || distance > radius) {
+		return 0.0f;
+	}
+
+	float scale = 6.684507f / std::pow(radius, 7.0f);  // 15/(pi * h^6)
+	float difference = radius - distance;
+
+	return scale * difference * difference * difference * difference;
+}
+
+float SPHSolver::NearDensityKernelDerivative(float distance, float radius)
+{
+	if (distance < 0.0f || distance > radius) {
+		return 0.0f;
+	}
+
+	float scale = 6.684507f / std::pow(radius, 7.0f);  // 15/(pi * h^6)
+	float difference = radius - distance;
+
+	return -4.0f * scale * difference * difference * difference;
+}
+
+void SPHSolver::Init(const SPHSolver::SimulationConfig& config)
+{
+	// the debug allocation check covers the thread running the solver and the pool workers
+	AllocationCounter::TrackCurrentThread();
+	// the kernels are picked by the first Init, a later one only rebuilds the solver for the new config
+	if (!s_Pool) {
+		SolverKernels::Init();
+		std::cout << "SPHSolver::Init: using the " << SolverKernels::GetISAName() << " solver kernels" << std::endl;
+	}
+	const uint32_t numThreads = config.NumThreads > 0 ? config.NumThreads : std::max(1u, std::thread::hardware_concurrency() / 2);
+	s_Pool = std::make_unique<ThreadPool>(numThreads);
+
+	// both buffers are sized once, the reordering only swaps them afterwards
+	Mdata.NumMolecules = config.NumMolecules;
+	Mdata.Buffers[0].Resize(Mdata.NumMolecules);
+	Mdata.Buffers[1].Resize(Mdata.NumMolecules);
+	Mdata.Properties = &Mdata.Buffers[0];
+	Mdata.BackProperties = &Mdata.Buffers[1];
+	SPHSolver::ResetMolecules(config);
+
+	Mdata.Ro0 = 30.0f;
+
+	Mdata.SpatialLookup = std::vector<SpatialLookupStruct>(Mdata.Properties->Size());
+	Mdata.StartIndices = std::vector<uint32_t>(Mdata.Properties->Size());
+	Mdata.EndIndices = std::vector<uint32_t>(Mdata.Properties->Size());
+
+	// scratch space of the counting sort, one histogram per worker
+	Mdata.SortScratch = std::vector<SpatialLookupStruct>(Mdata.Properties->Size());
+	Mdata.CellKeys = std::vector<uint32_t>(Mdata.Properties->Size());
+	Mdata.Histograms = std::vector<uint32_t>(Mdata.StartIndices.size() * s_Pool->GetNumThreads());
+	Mdata.TableSize = (uint32_t)Mdata.StartIndices.size();
+	Mdata.NeighbourCache = std::vector<NeighbourRanges>(s_Pool->GetNumThreads());
+	Mdata.Stamp = 0;
+	Mdata.RangeTotals = std::vector<uint32_t>(s_Pool->GetNumThreads());
+	Mdata.ChangedEntries = std::vector<SpatialLookupStruct>((size_t)(Mdata.Properties->Size() * MaxChangedFraction));
+	Mdata.ChangedCounts = std::vector<uint32_t>(s_Pool->GetNumThreads());
+	Mdata.SortedTableSize = 0;
+	Mdata.ChangedFraction = 0.0f;
+	Mdata.PartitionStamp = UINT32_MAX;
+	Mdata.MoleculeCosts = std::vector<uint32_t>(Mdata.Properties->Size());
+	Mdata.CostTotals = std::vector<uint64_t>(s_Pool->GetNumThreads());
+	Mdata.WorkBounds = std::vector<uint32_t>(s_Pool->GetNumThreads() + 1);
+
+	// the neighbour lists start with room for 16 neighbours per molecule and grow on demand
+	Mdata.ListStart = std::vector<uint32_t>(Mdata.Properties->Size() + 1);
+	Mdata.ListNeighbours = std::vector<uint32_t>(Mdata.Properties->Size() * 16);
+	Mdata.ListX.resize(Mdata.Properties->Size());
+	Mdata.ListY.resize(Mdata.Properties->Size());
+	Mdata.ListZ.resize(Mdata.Properties->Size());
+	Mdata.ListsValid = false;
+	Mdata.ListRebuilds = 0;
+
+	// the partial sums of the symmetric passes take a row per worker, so they wait until the mode is used
+	Mdata.PartialDensity = AlignedVector<float>();
+	Mdata.PartialNearDensity = AlignedVector<float>();
+	Mdata.PartialForceX = AlignedVector<float>();
+	Mdata.PartialForceY = AlignedVector<float>();
+	Mdata.PartialForceZ = AlignedVector<float>();
+
+	Mdata.Offsets = std::vector<glm::ivec3>(27);
+	Mdata.Offsets[0] = glm::ivec3(-1,  1, 0);
+	Mdata.Offsets[1] = glm::ivec3( 0,  1, 0);
+	Mdata.Offsets[2] = glm::ivec3( 1,  1, 0);
+	Mdata.Offsets[3] = glm::ivec3(-1,  0, 0);
+	Mdata.Offsets[4] = glm::ivec3( 0,  0, 0);
+	Mdata.Offsets[5] = glm::ivec3( 1,  0, 0);
+	Mdata.Offsets[6] = glm::ivec3(-1, -1, 0);
+	Mdata.Offsets[7] = glm::ivec3( 0, -1, 0);
+	Mdata.Offsets[8] = glm::ivec3( 1, -1, 0);
+
+	Mdata.Offsets[9] = glm::ivec3(-1,  1, -1);
+	Mdata.Offsets[10] = glm::ivec3( 0,  1, -1);
+	Mdata.Offsets[11] = glm::ivec3( 1,  1, -1);
+	Mdata.Offsets[12] = glm::ivec3(-1,  0, -1);
+	Mdata.Offsets[13] = glm::ivec3( 0,  0, -1);
+	Mdata.Offsets[14] = glm::ivec3( 1,  0, -1);
+	Mdata.Offsets[15] = glm::ivec3(-1, -1, -1);
+	Mdata.Offsets[16] = glm::ivec3( 0, -1, -1);
+	Mdata.Offsets[17] = glm::ivec3( 1, -1, -1);
+
+	Mdata.Offsets[18] = glm::ivec3(-1,  1, 1);
+	Mdata.Offsets[19] = glm::ivec3( 0,  1, 1);
+	Mdata.Offsets[20] = glm::ivec3( 1,  1, 1);
+	Mdata.Offsets[21] = glm::ivec3(-1,  0, 1);
+	Mdata.Offsets[22] = glm::ivec3( 0,  0, 1);
+	Mdata.Offsets[23] = glm::ivec3( 1,  0, 1);
+	Mdata.Offsets[24] = glm::ivec3(-1, -1, 1);
+	Mdata.Offsets[25] = glm::ivec3( 0, -1, 1);
+	Mdata.Offsets[26] = glm::ivec3( 1, -1, 1);
+}
+
+void SPHSolver::SolveCollisions(glm::vec3& position, glm::vec3& velocity, float scale, const glm::vec3& bounds)
+{
+	float lowestvertexPos = position.y - 0.5f * scale;
+	float highestvertexPos = position.y + 0.5f * scale;
+	float rightmostvertexPos = position.x + 0.5f * scale;
+	float leftmostvertexPos = position.x - 0.5f * scale;
+
+	float dampness = 0.05f;
+	if (highestvertexPos > -bounds.y) {
+		velocity.y = -velocity.y * dampness;
+		position.y = -bounds.y - 0.5f * scale;
+	}
+	if (lowestvertexPos < bounds.y) {
+		velocity.y = -velocity.y * dampness;
+		position.y = bounds.y + 0.5f * scale;
+	}
+	if (rightmostvertexPos > bounds.x) {
+		velocity.x = -velocity.x * dampness;
+		position.x = bounds.x - 0.5f * scale;
+	}
+	if (leftmostvertexPos < -bounds.x) {
+		velocity.x = -velocity.x * dampness;
+		position.x = -bounds.x + 0.5f * scale;
+	}
+}
+
+void SPHSolver::SymmetricDensityPass()
+{
+	const uint32_t numMolecules = Mdata.NumMolecules;
+	const uint32_t stride = Mdata.Properties->Size();
+	SPHSolver::MoleculeProperties& props = *Mdata.Properties;
+
+	// every pair is evaluated once and added to both molecules,
+	// each worker owns its partial sums so no two workers write the same slot
+	ForEachMoleculeByCost([&props, stride](uint32_t i) {
+		const uint32_t offset = ThreadPool::GetWorkerIndex() * stride;
+		float* partialDensity = &Mdata.PartialDensity[offset];
+		float* partialNearDensity = &Mdata.PartialNearDensity[offset];
+		const float px = props.PredictedX[i];
+		const float py = props.PredictedY[i];
+		const float pz = props.PredictedZ[i];
+		float density = 0.0f;
+		float nearDensity = 0.0f;
+
+		ForEachPair(i, glm::vec3(px, py, pz), [&props, px, py, pz, &density, &nearDensity, partialDensity, partialNearDensity](uint32_t other) {
+			float dx = px - props.PredictedX[other];
+			float dy = py - props.PredictedY[other];
+			float dz = pz - props.PredictedZ[other];
+			float distance = std::sqrt(dx * dx + dy * dy + dz * dz);
+			float influence = Mdata.Mass * SolverKernels::DensityKernel(s_Constants, distance);
+			float nearInfluence = Mdata.Mass * SolverKernels::NearDensityKernel(s_Constants, distance);
+			density += influence;
+			nearDensity += nearInfluence;
+			partialDensity[other] += influence;
+			partialNearDensity[other] += nearInfluence;
+		});
+
+		partialDensity[i] += density;
+		partialNearDensity[i] += nearDensity;
+	}, "Density pairs");
+
+	// sum the partial results and clear them for the next step
+	const uint32_t numThreads = s_Pool->GetNumThreads();
+	s_Pool->ParallelFor(numMolecules, [&props, stride, numThreads](uint32_t i) {
+		float density = 0.0f;
+		float nearDensity = 0.0f;
+		for (uint32_t w = 0; w < numThreads; w++) {
+			density += Mdata.PartialDensity[w * stride + i];
+			nearDensity += Mdata.PartialNearDensity[w * stride + i];
+			Mdata.PartialDensity[w * stride + i] = 0.0f;
+			Mdata.PartialNearDensity[w * stride + i] = 0.0f;
+		}
+		props.Density[i] = density;
+		props.NearDensity[i] = nearDensity;
+		props.Pressure[i] = 15.0f * (density - Mdata.Ro0);
+		props.NearPressure[i] = 2.0f * nearDensity;
+	}, "Density sum");
+}
+
+void SPHSolver::SymmetricForcePass(float dt)
+{
+	const uint32_t numMolecules = Mdata.NumMolecules;
+	const uint32_t stride = Mdata.Properties->Size();
+	SPHSolver::MoleculeProperties& props = *Mdata.Properties;
+
+	// the geometry and the kernels of a pair are shared, only the density of the other side differs
+	ForEachMoleculeByCost([&props, stride](uint32_t i) {
+		const uint32_t offset = ThreadPool::GetWorkerIndex() * stride;
+		float* forceX = &Mdata.PartialForceX[offset];
+		float* forceY = &Mdata.PartialForceY[offset];
+		float* forceZ = &Mdata.PartialForceZ[offset];
+		const glm::vec3 predicted = props.GetPredictedPosition(i);
+		const glm::vec3 velocity = props.GetVelocity(i);
+		glm::vec3 totalForce = glm::vec3(0.0f);
+
+		ForEachPair(i, predicted, [&props, i, &predicted, &velocity, &totalForce, forceX, forceY, forceZ](uint32_t other) {
+			// the same checks as the one sided pass, seen from each molecule
+			bool applyToI = props.Density[other] >= 0.01f && props.Density[i] >= 0.01f && props.NearDensity[other] >= 0.01f;
+			bool applyToOther = props.Density[other] >= 0.01f && props.Density[i] >= 0.01f && props.NearDensity[i] >= 0.01f;
+			if (!applyToI && !applyToOther) {
+				return;
+			}
+			glm::vec3 difference = predicted - props.GetPredictedPosition(other);
+			float length = glm::length(difference);
+			// if the length is too small, ignore
+			// molecules outside of the influence radius do not interact at all
+			if (length < 0.00001f || length > Mdata.h) {
+				return;
+			}
+			difference /= length;
+			float pressure = -0.5f * Mdata.Mass * (props.Pressure[i] + props.Pressure[other]) * SolverKernels::DensityKernelDerivative(s_Constants, length);
+			float nearPressure = -0.5f * Mdata.Mass * (props.NearPressure[i] + props.NearPressure[other]) * SolverKernels::NearDensityKernelDerivative(s_Constants, length);
+
+			// apply viscosity, unless the velocities are too close to get a direction
+			glm::vec3 relative = props.GetVelocity(other) - velocity;
+			float speed = glm::length(relative);
+			relative = speed < 0.00001f ? glm::vec3(0.0f) : relative / speed;
+
+			if (applyToI) {
+				totalForce += (pressure / props.Density[other] + nearPressure / props.NearDensity[other]) * difference;
+				totalForce += Mdata.Viscosity * Mdata.Mass / props.Density[other] * relative;
+			}
+			if (applyToOther) {
+				glm::vec3 force = -(pressure / props.Density[i] + nearPressure / props.NearDensity[i]) * difference;
+				force -= Mdata.Viscosity * Mdata.Mass / props.Density[i] * relative;
+				forceX[other] += force.x;
+				forceY[other] += force.y;
+				forceZ[other] += force.z;
+			}
+		});
+
+		forceX[i] += totalForce.x;
+		forceY[i] += totalForce.y;
+		forceZ[i] += totalForce.z;
+	}, "Force pairs");
+
+	// sum the partial forces and integrate, every velocity was read before any got updated
+	const uint32_t numThreads = s_Pool->GetNumThreads();
+	s_Pool->ParallelFor(numMolecules, [&props, dt, stride, numThreads](uint32_t i) {
+		glm::vec3 totalForce = glm::vec3(0.0f);
+		for (uint32_t w = 0; w < numThreads; w++) {
+			totalForce.x += Mdata.PartialForceX[w * stride + i];
+			totalForce.y += Mdata.PartialForceY[w * stride + i];
+			totalForce.z += Mdata.PartialForceZ[w * stride + i];
+			Mdata.PartialForceX[w * stride + i] = 0.0f;
+			Mdata.PartialForceY[w * stride + i] = 0.0f;
+			Mdata.PartialForceZ[w * stride + i] = 0.0f;
+		}
+
+		glm::vec3 velocity = props.GetVelocity(i) + dt / Mdata.Mass * totalForce;
+		glm::vec3 position = props.GetPosition(i) + dt * velocity;
+		props.SetPosition(i, position);
+		props.SetVelocity(i, velocity);
+	}, "Force sum");
+}
+
+void SPHSolver::OneSidedDensityPass()
+{
+	SPHSolver::MoleculeProperties& props = *Mdata.Properties;
+
+	// compute the density and pressure
+	ForEachMoleculeByCost([&props](uint32_t i) {
+		float density = 0.0f;
+		float nearDensity = 0.0f;
+
+		if (Mdata.ListsActive) {
+			// the list entries are scattered, so they go through the scalar kernels one at a time
+			ForEachNeighbour(i, props.GetPredictedPosition(i), [&props, i, &density, &nearDensity](uint32_t other) {
+				SolverKernels::AccumulateDensityScalar(s_Constants, props, i, other, other + 1, density, nearDensity);
+			});
+		}
+		else {
+			// every bucket of the 3x3 grid is a contiguous range of the sorted molecules
+			const SPHSolver::NeighbourRanges& ranges = SPHSolver::GetNeighbourRanges(SPHSolver::GetGridPosition(props.GetPredictedPosition(i)));
+			for (uint32_t k = 0; k < ranges.Count; k++) {
+				SolverKernels::AccumulateDensity(s_Constants, props, i, ranges.Begin[k], ranges.End[k], density, nearDensity);
+			}
+		}
+
+		props.Density[i] = density;
+		props.NearDensity[i] = nearDensity;
+		props.Pressure[i] = 15.0f * (density - Mdata.Ro0);
+		props.NearPressure[i] = 2.0f * nearDensity;
+	}, "Density slice");
+}
+
+void SPHSolver::OneSidedForcePass(float dt)
+{
+	SPHSolver::MoleculeProperties& props = *Mdata.Properties;
+
+	// compute the final total force, only starts once every density is known
+	ForEachMoleculeByCost([&props, dt](uint32_t i) {
+		glm::vec3 totalForce = glm::vec3(0.0f);
+
+		if (Mdata.ListsActive) {
+			ForEachNeighbour(i, props.GetPredictedPosition(i), [&props, i, &totalForce](uint32_t other) {
+				SolverKernels::AccumulateForceScalar(s_Constants, props, i, other, other + 1, totalForce);
+			});
+		}
+		else {
+			const SPHSolver::NeighbourRanges& ranges = SPHSolver::GetNeighbourRanges(SPHSolver::GetGridPosition(props.GetPredictedPosition(i)));
+			for (uint32_t k = 0; k < ranges.Count; k++) {
+				SolverKernels::AccumulateForce(s_Constants, props, i, ranges.Begin[k], ranges.End[k], totalForce);
+			}
+		}
+
+		glm::vec3 velocity = props.GetVelocity(i);
+		velocity += dt / Mdata.Mass * totalForce;
+		glm::vec3 position = props.GetPosition(i) + dt * velocity;
+
+		props.SetPosition(i, position);
+		props.SetVelocity(i, velocity);
+	}, "Force slice");
+}
+
+void SPHSolver::DensityPass()
+{
+	ProfileScope scope(Profiler::Section::DENSITY);
+	// each pair is only evaluated once in the symmetric mode
+	if (Mdata.Symmetric) {
+		SPHSolver::SymmetricDensityPass();
+	}
+	else {
+		SPHSolver::OneSidedDensityPass();
+	}
+}
+
+void SPHSolver::ForcePass(float dt)
+{
+	ProfileScope scope(Profiler::Section::FORCE);
+	if (Mdata.Symmetric) {
+		SPHSolver::SymmetricForcePass(dt);
+	}
+	else {
+		SPHSolver::OneSidedForcePass(dt);
+	}
+}
+
+void SPHSolver::ComputeCellKeys()
+{
+	// the keys of both sorts come from the predicted positions, computed in cache line aligned blocks
+	const uint32_t numMolecules = Mdata.NumMolecules;
+	const uint32_t numWorkers = s_Pool->GetNumThreads();
+	s_Pool->Dispatch([numMolecules, numWorkers](uint32_t worker) {
+		const uint32_t begin = (uint32_t)((uint64_t)numMolecules * worker / numWorkers) & ~15u;
+		const uint32_t end = worker + 1 == numWorkers ? numMolecules : (uint32_t)((uint64_t)numMolecules * (worker + 1) / numWorkers) & ~15u;
+		SolverKernels::ComputeCellKeys(s_KeyParams, *Mdata.Properties, begin, end, Mdata.CellKeys.data());
+		// the kernels number the dense grid row by row, the Z order is one lookup away
+		if (Mdata.ActiveIndexing == SPHSolver::CellIndexing::MORTON) {
+			const uint32_t outsideSlot = Mdata.TableSize - 1;
+			for (uint32_t i = begin; i < end; i++) {
+				const uint32_t key = Mdata.CellKeys[i];
+				Mdata.CellKeys[i] = key == outsideSlot ? key : Mdata.MortonSlots[key];
+			}
+		}
+	}, "Cell keys");
+}
+
+// every molecule costs a fixed amount on top of its neighbours, so sparse regions are not treated as free
+static constexpr uint32_t MoleculeOverhead = 8;
+
+void SPHSolver::PartitionWork()
+{
+	// the bounds only change when the molecules were reordered, or the lists rebuilt with them
+	if (Mdata.Partition != SPHSolver::WorkPartition::COST || Mdata.PartitionStamp == Mdata.Stamp) {
+		return;
+	}
+	ProfileScope scope(Profiler::Section::PARTITION);
+	const uint32_t numMolecules = Mdata.NumMolecules;
+	const uint32_t numWorkers = s_Pool->GetNumThreads();
+	s_Pool->Dispatch([numMolecules, numWorkers](uint32_t worker) {
+		// 1. estimate the cost of the worker's block, the run lengths of the 3x3 buckets or the list lengths
+		const uint32_t begin = (uint32_t)((uint64_t)numMolecules * worker / numWorkers) & ~15u;
+		const uint32_t end = worker + 1 == numWorkers ? numMolecules : (uint32_t)((uint64_t)numMolecules * (worker + 1) / numWorkers) & ~15u;
+		const SPHSolver::MoleculeProperties& props = *Mdata.Properties;
+		uint64_t blockCost = 0;
+		for (uint32_t i = begin; i < end; i++) {
+			uint32_t cost = MoleculeOverhead;
+			if (Mdata.ListsActive) {
+				cost += Mdata.ListStart[i + 1] - Mdata.ListStart[i];
+			}
+			else {
+				const SPHSolver::NeighbourRanges& ranges = SPHSolver::GetNeighbourRanges(SPHSolver::GetGridPosition(props.GetPredictedPosition(i)));
+				for (uint32_t k = 0; k < ranges.Count; k++) {
+					cost += ranges.End[k] - ranges.Begin[k];
+				}
+			}
+			Mdata.MoleculeCosts[i] = cost;
+			blockCost += cost;
+		}
+		Mdata.CostTotals[worker] = blockCost;
+		s_Pool->Barrier();
+
+		// 2. the split before worker k lies where the running cost reaches k / numWorkers of the total,
+		// every worker places the splits that fall into its own block
+		uint64_t offset = 0;
+		uint64_t total = 0;
+		for (uint32_t w = 0; w < numWorkers; w++) {
+			offset += w < worker ? Mdata.CostTotals[w] : 0;
+			total += Mdata.CostTotals[w];
+		}
+		uint64_t running = offset;
+		uint32_t i = begin;
+		for (uint32_t k = 1; k < numWorkers; k++) {
+			const uint64_t target = total * k / numWorkers;
+			if (target < offset || target >= offset + blockCost) {
+				continue;
+			}
+			while (running + Mdata.MoleculeCosts[i] <= target) {
+				running += Mdata.MoleculeCosts[i];
+				i++;
+			}
+			// the ranges start on a cache line, so two workers never write the same one
+			Mdata.WorkBounds[k] = std::min((i + 8) & ~15u, numMolecules);
+		}
+	}, "Cost partition");
+	Mdata.WorkBounds[0] = 0;
+	Mdata.WorkBounds[numWorkers] = numMolecules;
+	Mdata.PartitionStamp = Mdata.Stamp;
+}
+
+void SPHSolver::ResolveCollisions()
+{
+	ProfileScope scope(Profiler::Section::COLLISION);
+	// every worker takes a contiguous block for the wide loads, the blocks start on a cache line
+	const uint32_t numMolecules = Mdata.NumMolecules;
+	const uint32_t numWorkers = s_Pool->GetNumThreads();
+	SPHSolver::MoleculeProperties& props = *Mdata.Properties;
+	s_Pool->Dispatch([&props, numMolecules, numWorkers](uint32_t worker) {
+		const uint32_t begin = (uint32_t)((uint64_t)numMolecules * worker / numWorkers) & ~15u;
+		const uint32_t end = worker + 1 == numWorkers ? numMolecules : (uint32_t)((uint64_t)numMolecules * (worker + 1) / numWorkers) & ~15u;
+		SolverKernels::ResolveCollisions(s_Container, props, begin, end);
+	}, "Collision slice");
+}
+
+void SPHSolver::Update(float dt, const SPHSolver::SimulationConfig& config, const CollisionSolver::ContainerState& container)
+{
+#ifdef _DEBUG
+	const uint64_t allocationsBefore = AllocationCounter::GetCount();
+#endif
+	TraceScope trace("Solver step");
+
+	//dt = 0.0016666666f;
+	// make sure to update all that can be changed between steps
+	Mdata.Scale = config.MoleculeScale;
+	Mdata.h = config.InfluenceRadius;
+	Mdata.Viscosity = config.ViscosityStrength;
+	Mdata.Sort = config.Sort;
+	Mdata.Indexing = config.Indexing;
+	Mdata.UseLists = config.NeighbourLists;
+	Mdata.Skin = config.SkinDistance;
+	Mdata.Symmetric = config.SymmetricPairs;
+	s_Pool->SetGrainSize(config.GrainSize);
+	Mdata.Partition = config.Partition;
+	Mdata.CellSize = Mdata.UseLists ? Mdata.h + Mdata.Skin : Mdata.h;
+	Mdata.BuffersResized = false;
+	//Mdata.Mass = Mdata.h * Mdata.h * Mdata.h * Mdata.Ro0;
+	Mdata.Mass = 1.0f;
+	s_Constants = SolverKernels::MakeConstants(Mdata.h, Mdata.Mass, Mdata.Viscosity);
+	s_Container = container;
+
+	if (Mdata.Symmetric && Mdata.PartialDensity.empty()) {
+		const size_t partialSize = (size_t)Mdata.Properties->Size() * s_Pool->GetNumThreads();
+		Mdata.PartialDensity = AlignedVector<float>(partialSize, 0.0f);
+		Mdata.PartialNearDensity = AlignedVector<float>(partialSize, 0.0f);
+		Mdata.PartialForceX = AlignedVector<float>(partialSize, 0.0f);
+		Mdata.PartialForceY = AlignedVector<float>(partialSize, 0.0f);
+		Mdata.PartialForceZ = AlignedVector<float>(partialSize, 0.0f);
+		Mdata.BuffersResized = true;
+	}
+
+	// apply all the external forces and predict the position
+	{
+		ProfileScope scope(Profiler::Section::PREDICT);
+		SPHSolver::MoleculeProperties& props = *Mdata.Properties;
+		s_Pool->ParallelFor(Mdata.NumMolecules, [&props, dt](uint32_t i) {
+			props.VelocityY[i] += -9.81f * dt;
+			props.PredictedX[i] = props.PositionX[i] + props.VelocityX[i] * dt;
+			props.PredictedY[i] = props.PositionY[i] + props.VelocityY[i] * dt;
+			props.PredictedZ[i] = props.PositionZ[i] + props.VelocityZ[i] * dt;
+		}, "Predict slice");
+	}
+
+	// the cached lists are reused across steps, the grid is only rebuilt when they expire
+	// without lists, the grid is rebuilt every step
+	Mdata.ListsActive = false;
+	if (!Mdata.UseLists) {
+		SPHSolver::CheckNeighbours();
+	}
+	else if (SPHSolver::NeighbourListsExpired()) {
+		SPHSolver::CheckNeighbours();
+		SPHSolver::BuildNeighbourLists();
+	}
+	Mdata.ListsActive = Mdata.UseLists;
+	SPHSolver::PartitionWork();
+
+	SPHSolver::DensityPass();
+	SPHSolver::ForcePass(dt);
+	SPHSolver::ResolveCollisions();
+
+#ifdef _DEBUG
+	// every buffer is sized up front, so a step must never touch the heap
+	// unless the tables had to grow because the container, the radius or the neighbour count changed
+	assert((Mdata.BuffersResized || AllocationCounter::GetCount() == allocationsBefore) && "SPHSolver::Update allocated on the heap");
+#endif
+}
+
+uint32_t SPHSolver::GetNumThreads()
+{
+	return s_Pool->GetNumThreads();
+}
+
+float SPHSolver::SamplePoolUtilisation()
+{
+	return s_Pool->SampleUtilisation();
+}
+
+float SPHSolver::SampleBarrierIdle()
+{
+	return s_Pool->SampleBarrierIdle();
+}
+
+void SPHSolver::SetCollectStatistics(bool collect)
+{
+	s_CollectStatistics = collect;
+}
+
+const SPHSolver::GridStatistics& SPHSolver::GetGridStatistics()
+{
+	return s_Statistics;
+}
+
+uint64_t SPHSolver::GetListRebuilds()
+{
+	return Mdata.ListRebuilds;
+}
+
+float SPHSolver::GetAverageListLength()
+{
+	if (!Mdata.ListsValid) {
+		return 0.0f;
+	}
+	return (float)Mdata.ListStart[Mdata.NumMolecules] / Mdata.NumMolecules;
+}
+
+float SPHSolver::GetChangedFraction()
+{
+	return Mdata.ChangedFraction;
+}
+
+uint32_t SPHSolver::GetNumMolecules()
+{
+	return Mdata.NumMolecules;
+}
+
+SPHSolver::MoleculeProperties& SPHSolver::GetProperties()
+{
+	return *Mdata.Properties;
+}
@@ -0,0 +1,226 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <vector>
+
+#include "Core.h"
+#include "CollisionSolver.h"
+
+class SPHSolver
+{
+public:
+	// the state of all the molecules, stored as a structure of arrays
+	// each field lives in its own aligned array, so a pass only pulls the fields it reads into cache
+	struct MoleculeProperties
+	{
+		AlignedVector<float> PositionX, PositionY, PositionZ;
+		AlignedVector<float> PredictedX, PredictedY, PredictedZ;
+		AlignedVector<float> VelocityX, VelocityY, VelocityZ;
+		AlignedVector<float> Density;
+		AlignedVector<float> NearDensity;
+		AlignedVector<float> Pressure;
+		AlignedVector<float> NearPressure;
+
+		void Resize(size_t count);
+		size_t Size() const { return PositionX.size(); }
+
+		// per-molecule accessors that gather the separate components
+		glm::vec3 GetPosition(uint32_t i) const { return glm::vec3(PositionX[i], PositionY[i], PositionZ[i]); }
+		glm::vec3 GetPredictedPosition(uint32_t i) const { return glm::vec3(PredictedX[i], PredictedY[i], PredictedZ[i]); }
+		glm::vec3 GetVelocity(uint32_t i) const { return glm::vec3(VelocityX[i], VelocityY[i], VelocityZ[i]); }
+		void SetPosition(uint32_t i, const glm::vec3& v) { PositionX[i] = v.x; PositionY[i] = v.y; PositionZ[i] = v.z; }
+		void SetPredictedPosition(uint32_t i, const glm::vec3& v) { PredictedX[i] = v.x; PredictedY[i] = v.y; PredictedZ[i] = v.z; }
+		void SetVelocity(uint32_t i, const glm::vec3& v) { VelocityX[i] = v.x; VelocityY[i] = v.y; VelocityZ[i] = v.z; }
+	};
+
+	// the algorithm used to order the spatial lookup by hash code
+	enum class SortMethod
+	{
+		COMPARISON,  // std::sort, O(n log n)
+		COUNTING,    // parallel counting sort, O(n + table size)
+		INCREMENTAL  // only the molecules that changed cell are sorted and merged back, a counting sort when too many did
+	};
+
+	// how a grid cell is turned into a slot of the lookup tables
+	enum class CellIndexing
+	{
+		HASH,   // multiplicative hash into a table of NumMolecules slots, works for any domain
+		DENSE,  // one slot per cell of the grid covering the container, used when the domain is bounded
+		MORTON  // the dense grid with its slots numbered along the Z curve, so neighbouring cells sit close in memory
+	};
+
+	// how the passes whose cost follows the neighbour count are split between the workers
+	enum class WorkPartition
+	{
+		CHUNKS,  // chunks from a shared counter, balanced while the pass runs
+		COST     // one contiguous range per worker, with an equal share of the estimated neighbour visits
+	};
+
+	// neighbour search statistics, used to compare the cell indexing modes
+	struct GridStatistics
+	{
+		bool DenseGrid;             // false when the step fell back to hashing
+		glm::ivec3 GridSize;
+		uint32_t TableSize;
+		uint32_t OccupiedBuckets;
+		uint32_t CollidingBuckets;  // buckets holding molecules from more than one cell
+		uint64_t Candidates;        // molecules visited by the neighbour loops
+		uint64_t FalseCandidates;   // visited molecules that lie outside the 3x3 block
+	};
+
+	// the distinct, non-empty buckets of the 3x3 block around a cell, as ranges of the spatial lookup
+	// aligned so the per-worker copies do not share cache lines
+	struct alignas(64) NeighbourRanges
+	{
+		glm::ivec3 Cell;
+		uint32_t Stamp = 0;  // the step the ranges were computed for
+		uint32_t Count = 0;
+		uint32_t Begin[9];
+		uint32_t End[9];
+	};
+
+	// everything the solver needs from the outside, the application fills it from the UI every frame
+	struct SimulationConfig
+	{
+		uint32_t NumMolecules = 2048;
+		uint32_t NumThreads = 0;  // the size of the worker pool, 0 uses half of the hardware threads
+		glm::vec3 StartingBoxPosition = glm::vec3(-16.0f, 0.0f, 0.0f);
+		glm::vec3 StartingBoxScale = glm::vec3(7.0f, 21.0f, 1.0f);
+		float MoleculeScale = 0.515f;
+		float InfluenceRadius = 0.5f;
+		float ViscosityStrength = 1.0f;
+		SPHSolver::SortMethod Sort = SPHSolver::SortMethod::COUNTING;
+		SPHSolver::CellIndexing Indexing = SPHSolver::CellIndexing::DENSE;
+		bool NeighbourLists = false;
+		float SkinDistance = 0.1f;
+		bool SymmetricPairs = false;
+		uint32_t GrainSize = 0;  // molecules per chunk of the parallel passes, 0 sizes the chunks from the pool
+		SPHSolver::WorkPartition Partition = SPHSolver::WorkPartition::COST;
+	};
+
+	struct SpatialLookupStruct
+	{
+		uint32_t Index; // the position in the MoleculesData properties vector
+		uint32_t Hash;  // associated hash code
+	}; 
+	
+	struct MoleculesData
+	{
+		uint32_t NumMolecules;  // fixed at Init, every buffer is sized for it
+		float Scale;
+		float h;  // influence radius
+		float CellSize;  // the edge of a grid cell, h or h + skin when neighbour lists are used
+		float Mass;
+		float Ro0;  // fluid density at rest, measured in kg/m^3
+		float Viscosity;
+		SPHSolver::SortMethod Sort;
+		SPHSolver::CellIndexing Indexing;        // the mode requested through the UI
+		SPHSolver::CellIndexing ActiveIndexing;  // the mode used by the current step
+		glm::ivec3 GridOrigin;  // the first cell of the dense grid
+		glm::ivec3 GridSize;    // the number of cells of the dense grid on each axis
+		uint32_t TableSize;     // the number of slots in use in the start and end indices
+		std::vector<uint32_t> MortonSlots;  // the Z order slot of every cell of the dense grid, in row-major order
+		glm::ivec3 MortonGridSize;          // the grid the slots were numbered for
+		bool BuffersResized;    // set when the current step had to grow a table or the neighbour lists
+		SPHSolver::MoleculeProperties Buffers[2];
+		SPHSolver::MoleculeProperties* Properties;      // the current state, ordered like the spatial lookup
+		SPHSolver::MoleculeProperties* BackProperties;  // target of the reordering gather
+
+		std::vector<SPHSolver::SpatialLookupStruct> SpatialLookup;  // the array of neighbours
+		std::vector<uint32_t> StartIndices;		// the start positions of each hash code
+		std::vector<uint32_t> EndIndices;		// one past the last position of each hash code
+		std::vector<SPHSolver::SpatialLookupStruct> SortScratch;  // unsorted entries of the counting sort
+		std::vector<uint32_t> CellKeys;		// the key of every molecule, computed in blocks before the sort
+		std::vector<uint32_t> Histograms;		// per-worker code counts, reused as scatter offsets
+		std::vector<uint32_t> RangeTotals;		// per-worker sums of the prefix scan
+		std::vector<SPHSolver::SpatialLookupStruct> ChangedEntries;  // the molecules that changed cell, for the incremental sort
+		std::vector<uint32_t> ChangedCounts;	// per-worker counts of the changed molecules
+		uint32_t SortedTableSize;  // the table size of the last sort, the incremental sort needs the same one
+		float ChangedFraction;     // of the molecules that changed cell before the last incremental sort
+		std::vector<glm::ivec3> Offsets;        // the offsets that form the 3x3 grid around the molecule
+		std::vector<SPHSolver::NeighbourRanges> NeighbourCache;  // one per worker
+		uint32_t Stamp;  // incremented every time the lookup is rebuilt
+
+		// the split of the pair passes, estimated from the neighbour counts every time the molecules are reordered
+		SPHSolver::WorkPartition Partition;
+		uint32_t PartitionStamp;  // the lookup the bounds were computed for
+		std::vector<uint32_t> MoleculeCosts;  // the estimated cost of every molecule
+		std::vector<uint64_t> CostTotals;     // per-worker sums of the costs
+		std::vector<uint32_t> WorkBounds;     // worker w takes the molecules [WorkBounds[w], WorkBounds[w + 1])
+
+		// cached Verlet neighbour lists, every molecule within h + skin in compressed rows
+		bool UseLists;     // the mode requested through the UI
+		bool ListsActive;  // the passes iterate the lists instead of the grid
+		bool ListsValid;
+		bool ListsHalf;    // the lists hold each pair once, for the symmetric passes
+		float Skin;
+		float ListRadius;  // the radius the current lists were built with
+		uint64_t ListRebuilds;
+		std::vector<uint32_t> ListStart;       // the first entry of each molecule, plus the total at the end
+		std::vector<uint32_t> ListNeighbours;
+		AlignedVector<float> ListX, ListY, ListZ;  // the predicted positions at build time
+
+		// the symmetric passes evaluate each pair once and accumulate into per worker rows
+		bool Symmetric;
+		AlignedVector<float> PartialDensity, PartialNearDensity;
+		AlignedVector<float> PartialForceX, PartialForceY, PartialForceZ;
+	};
+
+public:
+	static void Init(const SPHSolver::SimulationConfig& config);
+	static void Update(float dt, const SPHSolver::SimulationConfig& config, const CollisionSolver::ContainerState& container);
+	static void ResetMolecules(const SPHSolver::SimulationConfig& config);
+
+	static glm::ivec3 GetGridPosition(const glm::vec3& pos);
+	static uint32_t GetHashCodeFromGrid(const glm::ivec3& gridPos);
+	static uint32_t GetDenseIndexFromGrid(const glm::ivec3& gridPos);
+	static uint32_t GetCellKey(const glm::ivec3& gridPos);
+	static const SPHSolver::NeighbourRanges& GetNeighbourRanges(const glm::ivec3& gridPos);
+	static void UpdateCellIndexing();
+	static void NumberMortonSlots();
+	static void ComputeCellKeys();
+	static void PartitionWork();
+	static bool NeighbourListsExpired();
+	static void BuildNeighbourLists();
+	static void DensityPass();
+	static void ForcePass(float dt);
+	static void OneSidedDensityPass();
+	static void OneSidedForcePass(float dt);
+	static void SymmetricDensityPass();
+	static void SymmetricForcePass(float dt);
+	static void ResolveCollisions();
+	static void CheckNeighbours();
+	static void CollectGridStatistics();
+	static void SortByComparison();
+	static void SortByCounting();
+	static bool SortIncrementally();
+
+	static float Kernel(float distance, float radius);
+	static float KernelDerivative(float distance, float radius);
+	static float ViscosityKernelLaplacian(float distance, float radius);
+	static float NearDensityKernel(float distance, float radius);
+	static float NearDensityKernelDerivative(float distance, float radius);
+
+	static void SolveCollisions(glm::vec3& position, glm::vec3& velocity, float scale, const glm::vec3& bounds);
+
+	static SPHSolver::MoleculeProperties& GetProperties();
+	static uint32_t GetNumMolecules();
+
+	// worker pool statistics, shown in the telemetry window
+	static uint32_t GetNumThreads();
+	static float SamplePoolUtilisation();
+	static float SampleBarrierIdle();
+	static void SetCollectStatistics(bool collect);
+	static const SPHSolver::GridStatistics& GetGridStatistics();
+	static uint64_t GetListRebuilds();
+	static float GetAverageListLength();
+	static float GetChangedFraction();
+
+
+private:
+	SPHSolver() = default;
+
+};
\ No newline at end of file
@@ -0,0 +1,186 @@
+#include "SolverKernels.h"
+
+#include <cmath>
+
+#include "CPUFeatures.h"
+
+// from the narrowest to the widest instruction set
+static const SolverKernels::Variant s_Variants[] = {
+	{ SolverKernels::ISA::SCALAR, "scalar", SolverKernels::AccumulateDensityScalar, SolverKernels::AccumulateForceScalar,
+		SolverKernels::ComputeCellKeysScalar, SolverKernels::ResolveCollisionsScalar },
+	{ SolverKernels::ISA::SSE42, "SSE4.2", SolverKernels::AccumulateDensitySSE42, SolverKernels::AccumulateForceSSE42,
+		SolverKernels::ComputeCellKeysSSE42, SolverKernels::ResolveCollisionsSSE42 },
+	{ SolverKernels::ISA::AVX2, "AVX2", SolverKernels::AccumulateDensityAVX2, SolverKernels::AccumulateForceAVX2,
+		SolverKernels::ComputeCellKeysAVX2, SolverKernels::ResolveCollisionsAVX2 },
+	{ SolverKernels::ISA::AVX512, "AVX-512", SolverKernels::AccumulateDensityAVX512, SolverKernels::AccumulateForceAVX512,
+		SolverKernels::ComputeCellKeysAVX512, SolverKernels::ResolveCollisionsAVX512 },
+};
+
+static struct KernelData
+{
+	const SolverKernels::Variant* Active = &s_Variants[0];
+} Kdata;
+
+std::span<const SolverKernels::Variant> SolverKernels::GetVariants()
+{
+	return s_Variants;
+}
+
+bool SolverKernels::IsSupported(SolverKernels::ISA isa)
+{
+	switch (isa) {
+	case SolverKernels::ISA::AVX512:
+		return CPUFeatures::HasAVX512();
+	case SolverKernels::ISA::AVX2:
+		return CPUFeatures::HasAVX2();
+	case SolverKernels::ISA::SSE42:
+		return CPUFeatures::HasSSE42();
+	default:
+		return true;
+	}
+}
+
+void SolverKernels::Init()
+{
+	for (const SolverKernels::Variant& variant : s_Variants) {
+		if (SolverKernels::IsSupported(variant.ISA)) {
+			Kdata.Active = &variant;
+		}
+	}
+}
+
+SolverKernels::ISA SolverKernels::GetISA()
+{
+	return Kdata.Active->ISA;
+}
+
+const char* SolverKernels::GetISAName()
+{
+	return Kdata.Active->Name;
+}
+
+SolverKernels::Constants SolverKernels::MakeConstants(float radius, float mass, float viscosity)
+{
+	SolverKernels::Constants c;
+	c.Radius = radius;
+	c.Scale = 4.774648f / std::pow(radius, 6.0f);  // 15/(pi * h^6)
+	c.NearScale = 6.684507f / std::pow(radius, 7.0f);  // 21/(pi * h^7)
+	c.Mass = mass;
+	c.Viscosity = viscosity;
+	return c;
+}
+
+void SolverKernels::AccumulateDensity(const SolverKernels::Constants& c, const SPHSolver::MoleculeProperties& props,
+	uint32_t self, uint32_t begin, uint32_t end, float& density, float& nearDensity)
+{
+	Kdata.Active->Density(c, props, self, begin, end, density, nearDensity);
+}
+
+void SolverKernels::AccumulateForce(const SolverKernels::Constants& c, const SPHSolver::MoleculeProperties& props,
+	uint32_t self, uint32_t begin, uint32_t end, glm::vec3& force)
+{
+	Kdata.Active->Force(c, props, self, begin, end, force);
+}
+
+void SolverKernels::ComputeCellKeys(const SolverKernels::CellKeyParams& params, const SPHSolver::MoleculeProperties& props,
+	uint32_t begin, uint32_t end, uint32_t* keys)
+{
+	Kdata.Active->CellKeys(params, props, begin, end, keys);
+}
+
+void SolverKernels::ResolveCollisions(const CollisionSolver::ContainerState& container, SPHSolver::MoleculeProperties& props,
+	uint32_t begin, uint32_t end)
+{
+	Kdata.Active->Collisions(container, props, begin, end);
+}
+
+void SolverKernels::AccumulateDensityScalar(const SolverKernels::Constants& c, const SPHSolver::MoleculeProperties& props,
+	uint32_t self, uint32_t begin, uint32_t end, float& density, float& nearDensity)
+{
+	const float px = props.PredictedX[self];
+	const float py = props.PredictedY[self];
+	const float pz = props.PredictedZ[self];
+	for (uint32_t j = begin; j < end; j++) {
+		// a particle should not influence itself
+		if (j == self) {
+			continue;
+		}
+		float dx = px - props.PredictedX[j];
+		float dy = py - props.PredictedY[j];
+		float dz = pz - props.PredictedZ[j];
+		float distance = std::sqrt(dx * dx + dy * dy + dz * dz);
+		density += c.Mass * SolverKernels::DensityKernel(c, distance);
+		nearDensity += c.Mass * SolverKernels::NearDensityKernel(c, distance);
+	}
+}
+
+void SolverKernels::AccumulateForceScalar(const SolverKernels::Constants& c, const SPHSolver::MoleculeProperties& props,
+	uint32_t self, uint32_t begin, uint32_t end, glm::vec3& force)
+{
+	if (props.Density[self] < 0.01f) {
+		return;
+	}
+	const glm::vec3 predicted = props.GetPredictedPosition(self);
+	const glm::vec3 velocity = props.GetVelocity(self);
+	for (uint32_t j = begin; j < end; j++) {
+		if (props.Density[j] < 0.01f || props.NearDensity[j] < 0.01f) {
+			continue;
+		}
+		glm::vec3 difference = predicted - props.GetPredictedPosition(j);
+		float length = glm::length(difference);
+		// if the length is too small, ignore
+		// molecules outside of the influence radius do not interact at all
+		if (length < 0.00001f || length > c.Radius) {
+			continue;
+		}
+		difference /= length;
+		float aux = (props.Pressure[self] + props.Pressure[j]) / (2.0f * props.Density[j]);
+		force += -aux * SolverKernels::DensityKernelDerivative(c, length) * c.Mass * difference;
+
+		aux = (props.NearPressure[self] + props.NearPressure[j]) / (2.0f * props.NearDensity[j]);
+		force += c.Mass * aux * -SolverKernels::NearDensityKernelDerivative(c, length) * difference;
+
+		// apply viscosity, unless the velocities are too close to get a direction
+		difference = props.GetVelocity(j) - velocity;
+		length = glm::length(difference);
+		if (length < 0.00001f) {
+			continue;
+		}
+		force += c.Viscosity * c.Mass / props.Density[j] * (difference / length);
+	}
+}
+
+void SolverKernels::ComputeCellKeysScalar(const SolverKernels::CellKeyParams& params, const SPHSolver::MoleculeProperties& props,
+	uint32_t begin, uint32_t end, uint32_t* keys)
+{
+	for (uint32_t i = begin; i < end; i++) {
+		// the same as SPHSolver::GetGridPosition, the grid is flat along z
+		const int x = (int)std::floor(props.PredictedX[i] / params.CellSize);
+		const int y = (int)std::floor(props.PredictedY[i] / params.CellSize);
+		if (!params.Dense) {
+			keys[i] = (((uint32_t)x * 73856093u) ^ ((uint32_t)y * 19349663u)) % params.HashSize;
+			continue;
+		}
+		const int localX = x - params.GridOrigin.x;
+		const int localY = y - params.GridOrigin.y;
+		const int localZ = -params.GridOrigin.z;
+		if (localX < 0 || localY < 0 || localZ < 0
+			|| localX >= params.GridSize.x || localY >= params.GridSize.y || localZ >= params.GridSize.z) {
+			keys[i] = params.OutsideSlot;
+			continue;
+		}
+		keys[i] = (uint32_t)((localZ * params.GridSize.y + localY) * params.GridSize.x + localX);
+	}
+}
+
+void SolverKernels::ResolveCollisionsScalar(const CollisionSolver::ContainerState& container, SPHSolver::MoleculeProperties& props,
+	uint32_t begin, uint32_t end)
+{
+	for (uint32_t i = begin; i < end; i++) {
+		glm::vec3 position = props.GetPosition(i);
+		glm::vec3 velocity = props.GetVelocity(i);
+		CollisionSolver::ContainerCollision(container, position, velocity);
+		props.SetPosition(i, position);
+		props.SetVelocity(i, velocity);
+	}
+}
@@ -0,0 +1,154 @@
+#pragma once
+
+#include "SPHSolver.h"
+#include "CollisionSolver.h"
+
+#include <span>
+
+// the hot loops of the solver over contiguous ranges of molecules, compiled once per instruction set
+// the molecules of a grid cell are stored next to each other, so every bucket of the 3x3 block is one range
+class SolverKernels
+{
+public:
+	enum class ISA
+	{
+		SCALAR, SSE42, AVX2, AVX512
+	};
+
+	// everything that only depends on the radius is computed once per step instead of once per pair
+	struct Constants
+	{
+		float Radius;
+		float Scale;      // 15/(pi * h^6)
+		float NearScale;  // 21/(pi * h^7)
+		float Mass;
+		float Viscosity;
+	};
+
+	// what SPHSolver::GetCellKey needs, copied out of the solver data once per step
+	struct CellKeyParams
+	{
+		float CellSize;
+		bool Dense;
+		glm::ivec3 GridOrigin;
+		glm::ivec3 GridSize;
+		uint32_t OutsideSlot;  // the empty slot of the cells outside of the dense grid
+		uint32_t HashSize;
+	};
+
+	using DensityFunc = void(*)(const SolverKernels::Constants& c, const SPHSolver::MoleculeProperties& props,
+		uint32_t self, uint32_t begin, uint32_t end, float& density, float& nearDensity);
+	using ForceFunc = void(*)(const SolverKernels::Constants& c, const SPHSolver::MoleculeProperties& props,
+		uint32_t self, uint32_t begin, uint32_t end, glm::vec3& force);
+	using CellKeysFunc = void(*)(const SolverKernels::CellKeyParams& params, const SPHSolver::MoleculeProperties& props,
+		uint32_t begin, uint32_t end, uint32_t* keys);
+	using CollisionsFunc = void(*)(const CollisionSolver::ContainerState& container, SPHSolver::MoleculeProperties& props,
+		uint32_t begin, uint32_t end);
+
+	struct Variant
+	{
+		SolverKernels::ISA ISA;
+		const char* Name;
+		SolverKernels::DensityFunc Density;
+		SolverKernels::ForceFunc Force;
+		SolverKernels::CellKeysFunc CellKeys;
+		SolverKernels::CollisionsFunc Collisions;
+	};
+
+public:
+	// picks the widest instruction set the processor supports, once for the whole run
+	static void Init();
+	static SolverKernels::ISA GetISA();
+	static const char* GetISAName();
+	// every compiled variant from the narrowest to the widest instruction set, the tests compare them all
+	static std::span<const SolverKernels::Variant> GetVariants();
+	static bool IsSupported(SolverKernels::ISA isa);
+	static SolverKernels::Constants MakeConstants(float radius, float mass, float viscosity);
+
+	// adds the contributions of the molecules in [begin, end) to the molecule self, which is skipped if inside the range
+	static void AccumulateDensity(const SolverKernels::Constants& c, const SPHSolver::MoleculeProperties& props,
+		uint32_t self, uint32_t begin, uint32_t end, float& density, float& nearDensity);
+	static void AccumulateForce(const SolverKernels::Constants& c, const SPHSolver::MoleculeProperties& props,
+		uint32_t self, uint32_t begin, uint32_t end, glm::vec3& force);
+	// the grid key of every molecule in [begin, end), from its predicted position
+	static void ComputeCellKeys(const SolverKernels::CellKeyParams& params, const SPHSolver::MoleculeProperties& props,
+		uint32_t begin, uint32_t end, uint32_t* keys);
+	// keeps the molecules in [begin, end) inside of the container
+	static void ResolveCollisions(const CollisionSolver::ContainerState& container, SPHSolver::MoleculeProperties& props,
+		uint32_t begin, uint32_t end);
+
+	// the kernels of a single pair with the hoisted constants
+	static inline float DensityKernel(const SolverKernels::Constants& c, float distance)
+	{
+		if (distance > c.Radius) {
+			return 0.0f;
+		}
+		float difference = c.Radius - distance;
+		return c.Scale * difference * difference * difference;
+	}
+
+	static inline float DensityKernelDerivative(const SolverKernels::Constants& c, float distance)
+	{
+		if (distance > c.Radius) {
+			return 0.0f;
+		}
+		float difference = c.Radius - distance;
+		return -3.0f * c.Scale * difference * difference;
+	}
+
+	static inline float NearDensityKernel(const SolverKernels::Constants& c, float distance)
+	{
+		if (distance > c.Radius) {
+			return 0.0f;
+		}
+		float difference = c.Radius - distance;
+		return c.NearScale * difference * difference * difference * difference;
+	}
+
+	static inline float NearDensityKernelDerivative(const SolverKernels::Constants& c, float distance)
+	{
+		if (distance > c.Radius) {
+			return 0.0f;
+		}
+		float difference = c.Radius - distance;
+		return -4.0f * c.NearScale * difference * difference * difference;
+	}
+
+	// one implementation per instruction set, the SIMD ones hand the tail of the range to the scalar one
+	static void AccumulateDensityScalar(const SolverKernels::Constants& c, const SPHSolver::MoleculeProperties& props,
+		uint32_t self, uint32_t begin, uint32_t end, float& density, float& nearDensity);
+	static void AccumulateForceScalar(const SolverKernels::Constants& c, const SPHSolver::MoleculeProperties& props,
+		uint32_t self, uint32_t begin, uint32_t end, glm::vec3& force);
+	static void ComputeCellKeysScalar(const SolverKernels::CellKeyParams& params, const SPHSolver::MoleculeProperties& props,
+		uint32_t begin, uint32_t end, uint32_t* keys);
+	static void ResolveCollisionsScalar(const CollisionSolver::ContainerState& container, SPHSolver::MoleculeProperties& props,
+		uint32_t begin, uint32_t end);
+
+	static void AccumulateDensitySSE42(const SolverKernels::Constants& c, const SPHSolver::MoleculeProperties& props,
+		uint32_t self, uint32_t begin, uint32_t end, float& density, float& nearDensity);
+	static void AccumulateForceSSE42(const SolverKernels::Constants& c, const SPHSolver::MoleculeProperties& props,
+		uint32_t self, uint32_t begin, uint32_t end, glm::vec3& force);
+	static void ComputeCellKeysSSE42(const SolverKernels::CellKeyParams& params, const SPHSolver::MoleculeProperties& props,
+		uint32_t begin, uint32_t end, uint32_t* keys);
+	static void ResolveCollisionsSSE42(const CollisionSolver::ContainerState& container, SPHSolver::MoleculeProperties& props,
+		uint32_t begin, uint32_t end);
+
+	static void AccumulateDensityAVX2(const SolverKernels::Constants& c, const SPHSolver::MoleculeProperties& props,
+		uint32_t self, uint32_t begin, uint32_t end, float& density, float& nearDensity);
+	static void AccumulateForceAVX2(const SolverKernels::Constants& c, const SPHSolver::MoleculeProperties& props,
+		uint32_t self, uint32_t begin, uint32_t end, glm::vec3& force);
+	static void ComputeCellKeysAVX2(const SolverKernels::CellKeyParams& params, const SPHSolver::MoleculeProperties& props,
+		uint32_t begin, uint32_t end, uint32_t* keys);
+	static void ResolveCollisionsAVX2(const CollisionSolver::ContainerState& container, SPHSolver::MoleculeProperties& props,
+		uint32_t begin, uint32_t end);
+
+	static void AccumulateDensityAVX512(const SolverKernels::Constants& c, const SPHSolver::MoleculeProperties& props,
+		uint32_t self, uint32_t begin, uint32_t end, float& density, float& nearDensity);
+	static void AccumulateForceAVX512(const SolverKernels::Constants& c, const SPHSolver::MoleculeProperties& props,
+		uint32_t self, uint32_t begin, uint32_t end, glm::vec3& force);
+	static void ComputeCellKeysAVX512(const SolverKernels::CellKeyParams& params, const SPHSolver::MoleculeProperties& props,
+		uint32_t begin, uint32_t end, uint32_t* keys);
+	static void ResolveCollisionsAVX512(const CollisionSolver::ContainerState& container, SPHSolver::MoleculeProperties& props,
+		uint32_t begin, uint32_t end);
+
+};
@@ -0,0 +1,244 @@
+#include "SolverKernels.h"
+
+#include <immintrin.h>
+
+// compiled with AVX2 enabled, only ever called when the processor supports it
+
+static inline float HorizontalSum(__m256 v)
+{
+	__m128 sum = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+	sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+	sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+	return _mm_cvtss_f32(sum);
+}
+
+void SolverKernels::AccumulateDensityAVX2(const SolverKernels::Constants& c, const SPHSolver::MoleculeProperties& props,
+	uint32_t self, uint32_t begin, uint32_t end, float& density, float& nearDensity)
+{
+	const __m256 px = _mm256_set1_ps(props.PredictedX[self]);
+	const __m256 py = _mm256_set1_ps(props.PredictedY[self]);
+	const __m256 pz = _mm256_set1_ps(props.PredictedZ[self]);
+	const __m256 radius = _mm256_set1_ps(c.Radius);
+	const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	const __m256i selfIndex = _mm256_set1_epi32((int)self);
+	__m256 sum = _mm256_setzero_ps();
+	__m256 nearSum = _mm256_setzero_ps();
+
+	uint32_t j = begin;
+	for (; j + 8 <= end; j += 8) {
+		__m256 dx = _mm256_sub_ps(px, _mm256_loadu_ps(&props.PredictedX[j]));
+		__m256 dy = _mm256_sub_ps(py, _mm256_loadu_ps(&props.PredictedY[j]));
+		__m256 dz = _mm256_sub_ps(pz, _mm256_loadu_ps(&props.PredictedZ[j]));
+		__m256 distance = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz)));
+
+		// candidates outside of the radius and the molecule itself contribute nothing
+		__m256 inside = _mm256_cmp_ps(distance, radius, _CMP_LE_OQ);
+		__m256 isSelf = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_add_epi32(_mm256_set1_epi32((int)j), lanes), selfIndex));
+		__m256 difference = _mm256_and_ps(_mm256_andnot_ps(isSelf, inside), _mm256_sub_ps(radius, distance));
+
+		__m256 difference3 = _mm256_mul_ps(_mm256_mul_ps(difference, difference), difference);
+		sum = _mm256_add_ps(sum, difference3);
+		nearSum = _mm256_add_ps(nearSum, _mm256_mul_ps(difference3, difference));
+	}
+
+	density += c.Mass * c.Scale * HorizontalSum(sum);
+	nearDensity += c.Mass * c.NearScale * HorizontalSum(nearSum);
+	SolverKernels::AccumulateDensityScalar(c, props, self, j, end, density, nearDensity);
+}
+
+void SolverKernels::AccumulateForceAVX2(const SolverKernels::Constants& c, const SPHSolver::MoleculeProperties& props,
+	uint32_t self, uint32_t begin, uint32_t end, glm::vec3& force)
+{
+	if (props.Density[self] < 0.01f) {
+		return;
+	}
+	const __m256 px = _mm256_set1_ps(props.PredictedX[self]);
+	const __m256 py = _mm256_set1_ps(props.PredictedY[self]);
+	const __m256 pz = _mm256_set1_ps(props.PredictedZ[self]);
+	const __m256 vx = _mm256_set1_ps(props.VelocityX[self]);
+	const __m256 vy = _mm256_set1_ps(props.VelocityY[self]);
+	const __m256 vz = _mm256_set1_ps(props.VelocityZ[self]);
+	const __m256 pressure = _mm256_set1_ps(props.Pressure[self]);
+	const __m256 nearPressure = _mm256_set1_ps(props.NearPressure[self]);
+	const __m256 radius = _mm256_set1_ps(c.Radius);
+	const __m256 minDensity = _mm256_set1_ps(0.01f);
+	const __m256 minLength = _mm256_set1_ps(0.00001f);
+	// -aux * slope * m folds into 3/2 m s (h - r)^2 (Pi + Pj) / rho_j, and 2 m s_near (h - r)^3 for the near pressure
+	const __m256 pressureScale = _mm256_set1_ps(1.5f * c.Mass * c.Scale);
+	const __m256 nearPressureScale = _mm256_set1_ps(2.0f * c.Mass * c.NearScale);
+	const __m256 viscosityScale = _mm256_set1_ps(c.Viscosity * c.Mass);
+	__m256 fx = _mm256_setzero_ps();
+	__m256 fy = _mm256_setzero_ps();
+	__m256 fz = _mm256_setzero_ps();
+
+	uint32_t j = begin;
+	for (; j + 8 <= end; j += 8) {
+		__m256 rho = _mm256_loadu_ps(&props.Density[j]);
+		__m256 nearRho = _mm256_loadu_ps(&props.NearDensity[j]);
+		__m256 dx = _mm256_sub_ps(px, _mm256_loadu_ps(&props.PredictedX[j]));
+		__m256 dy = _mm256_sub_ps(py, _mm256_loadu_ps(&props.PredictedY[j]));
+		__m256 dz = _mm256_sub_ps(pz, _mm256_loadu_ps(&props.PredictedZ[j]));
+		__m256 length = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz)));
+
+		// the same early exits as the scalar loop, as a lane mask
+		__m256 valid = _mm256_and_ps(_mm256_cmp_ps(rho, minDensity, _CMP_GE_OQ), _mm256_cmp_ps(nearRho, minDensity, _CMP_GE_OQ));
+		valid = _mm256_and_ps(valid, _mm256_cmp_ps(length, minLength, _CMP_GE_OQ));
+		valid = _mm256_and_ps(valid, _mm256_cmp_ps(length, radius, _CMP_LE_OQ));
+
+		__m256 difference = _mm256_sub_ps(radius, length);
+		__m256 difference2 = _mm256_mul_ps(difference, difference);
+		__m256 pressureTerm = _mm256_div_ps(_mm256_mul_ps(_mm256_mul_ps(pressureScale, difference2), _mm256_add_ps(pressure, _mm256_loadu_ps(&props.Pressure[j]))), rho);
+		__m256 nearPressureTerm = _mm256_div_ps(_mm256_mul_ps(_mm256_mul_ps(nearPressureScale, _mm256_mul_ps(difference2, difference)), _mm256_add_ps(nearPressure, _mm256_loadu_ps(&props.NearPressure[j]))), nearRho);
+		// the masked lanes may hold inf or nan, clearing the bits removes them
+		__m256 coefficient = _mm256_and_ps(valid, _mm256_div_ps(_mm256_add_ps(pressureTerm, nearPressureTerm), length));
+		fx = _mm256_add_ps(fx, _mm256_mul_ps(coefficient, dx));
+		fy = _mm256_add_ps(fy, _mm256_mul_ps(coefficient, dy));
+		fz = _mm256_add_ps(fz, _mm256_mul_ps(coefficient, dz));
+
+		// apply viscosity, unless the velocities are too close to get a direction
+		__m256 dvx = _mm256_sub_ps(_mm256_loadu_ps(&props.VelocityX[j]), vx);
+		__m256 dvy = _mm256_sub_ps(_mm256_loadu_ps(&props.VelocityY[j]), vy);
+		__m256 dvz = _mm256_sub_ps(_mm256_loadu_ps(&props.VelocityZ[j]), vz);
+		__m256 speed = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dvx, dvx), _mm256_mul_ps(dvy, dvy)), _mm256_mul_ps(dvz, dvz)));
+		__m256 moving = _mm256_and_ps(valid, _mm256_cmp_ps(speed, minLength, _CMP_GE_OQ));
+		coefficient = _mm256_and_ps(moving, _mm256_div_ps(viscosityScale, _mm256_mul_ps(rho, speed)));
+		fx = _mm256_add_ps(fx, _mm256_mul_ps(coefficient, dvx));
+		fy = _mm256_add_ps(fy, _mm256_mul_ps(coefficient, dvy));
+		fz = _mm256_add_ps(fz, _mm256_mul_ps(coefficient, dvz));
+	}
+
+	force += glm::vec3(HorizontalSum(fx), HorizontalSum(fy), HorizontalSum(fz));
+	SolverKernels::AccumulateForceScalar(c, props, self, j, end, force);
+}
+
+void SolverKernels::ComputeCellKeysAVX2(const SolverKernels::CellKeyParams& params, const SPHSolver::MoleculeProperties& props,
+	uint32_t begin, uint32_t end, uint32_t* keys)
+{
+	const __m256 cellSize = _mm256_set1_ps(params.CellSize);
+	const int localZ = -params.GridOrigin.z;
+	uint32_t i = begin;
+
+	if (!params.Dense) {
+		const __m256i primeX = _mm256_set1_epi32(73856093);
+		const __m256i primeY = _mm256_set1_epi32(19349663);
+		for (; i + 8 <= end; i += 8) {
+			// the division is kept, a multiplication by the inverse could snap to another cell on the borders
+			__m256i x = _mm256_cvttps_epi32(_mm256_floor_ps(_mm256_div_ps(_mm256_loadu_ps(&props.PredictedX[i]), cellSize)));
+			__m256i y = _mm256_cvttps_epi32(_mm256_floor_ps(_mm256_div_ps(_mm256_loadu_ps(&props.PredictedY[i]), cellSize)));
+			_mm256_storeu_si256((__m256i*)&keys[i], _mm256_xor_si256(_mm256_mullo_epi32(x, primeX), _mm256_mullo_epi32(y, primeY)));
+			// there is no vector integer division, so the modulo stays scalar
+			for (uint32_t k = i; k < i + 8; k++) {
+				keys[k] %= params.HashSize;
+			}
+		}
+	}
+	else if (localZ >= 0 && localZ < params.GridSize.z) {
+		const __m256i originX = _mm256_set1_epi32(params.GridOrigin.x);
+		const __m256i originY = _mm256_set1_epi32(params.GridOrigin.y);
+		const __m256i sizeX = _mm256_set1_epi32(params.GridSize.x);
+		const __m256i sizeY = _mm256_set1_epi32(params.GridSize.y);
+		const __m256i layer = _mm256_set1_epi32(localZ * params.GridSize.y);
+		const __m256i outside = _mm256_set1_epi32((int)params.OutsideSlot);
+		const __m256i minusOne = _mm256_set1_epi32(-1);
+		for (; i + 8 <= end; i += 8) {
+			__m256i x = _mm256_sub_epi32(_mm256_cvttps_epi32(_mm256_floor_ps(_mm256_div_ps(_mm256_loadu_ps(&props.PredictedX[i]), cellSize))), originX);
+			__m256i y = _mm256_sub_epi32(_mm256_cvttps_epi32(_mm256_floor_ps(_mm256_div_ps(_mm256_loadu_ps(&props.PredictedY[i]), cellSize))), originY);
+			__m256i inside = _mm256_and_si256(_mm256_cmpgt_epi32(x, minusOne), _mm256_cmpgt_epi32(sizeX, x));
+			inside = _mm256_and_si256(inside, _mm256_and_si256(_mm256_cmpgt_epi32(y, minusOne), _mm256_cmpgt_epi32(sizeY, y)));
+			__m256i index = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_add_epi32(layer, y), sizeX), x);
+			_mm256_storeu_si256((__m256i*)&keys[i], _mm256_blendv_epi8(outside, index, inside));
+		}
+	}
+
+	// the tail, and the whole range when the flat grid lies outside of the dense one
+	SolverKernels::ComputeCellKeysScalar(params, props, i, end, keys);
+}
+
+// the columns of an affine matrix, the last one being the translation
+struct AffineAVX2
+{
+	__m256 Column[4][3];
+};
+
+static inline AffineAVX2 Broadcast(const glm::mat4& m)
+{
+	AffineAVX2 result;
+	for (int column = 0; column < 4; column++) {
+		for (int row = 0; row < 3; row++) {
+			result.Column[column][row] = _mm256_set1_ps(m[column][row]);
+		}
+	}
+	return result;
+}
+
+static inline void Apply(const AffineAVX2& m, __m256& x, __m256& y, __m256& z)
+{
+	__m256 rx = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m.Column[0][0], x), _mm256_mul_ps(m.Column[1][0], y)), _mm256_mul_ps(m.Column[2][0], z)), m.Column[3][0]);
+	__m256 ry = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m.Column[0][1], x), _mm256_mul_ps(m.Column[1][1], y)), _mm256_mul_ps(m.Column[2][1], z)), m.Column[3][1]);
+	__m256 rz = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m.Column[0][2], x), _mm256_mul_ps(m.Column[1][2], y)), _mm256_mul_ps(m.Column[2][2], z)), m.Column[3][2]);
+	x = rx;
+	y = ry;
+	z = rz;
+}
+
+// set where both coordinates are inside the wall's extent
+static inline __m256 Across(__m256 a, __m256 b)
+{
+	const __m256 low = _mm256_set1_ps(-0.6f);
+	const __m256 high = _mm256_set1_ps(0.6f);
+	__m256 acrossA = _mm256_and_ps(_mm256_cmp_ps(a, low, _CMP_GT_OQ), _mm256_cmp_ps(a, high, _CMP_LT_OQ));
+	__m256 acrossB = _mm256_and_ps(_mm256_cmp_ps(b, low, _CMP_GT_OQ), _mm256_cmp_ps(b, high, _CMP_LT_OQ));
+	return _mm256_and_ps(acrossA, acrossB);
+}
+
+// puts the molecules that went through the wall back on it and reflects their velocity
+static inline void Bounce(__m256& position, __m256& velocity, __m256 hit, float wall)
+{
+	velocity = _mm256_blendv_ps(velocity, _mm256_mul_ps(_mm256_set1_ps(-0.5f), velocity), hit);
+	position = _mm256_blendv_ps(position, _mm256_set1_ps(wall), hit);
+}
+
+void SolverKernels::ResolveCollisionsAVX2(const CollisionSolver::ContainerState& container, SPHSolver::MoleculeProperties& props,
+	uint32_t begin, uint32_t end)
+{
+	if (container.Degenerate) {
+		return;
+	}
+	const AffineAVX2 toLocal = Broadcast(container.InverseTransform);
+	const AffineAVX2 toWorld = Broadcast(container.Transform);
+	const AffineAVX2 rotateToLocal = Broadcast(glm::mat4(container.InverseRotation));
+	const AffineAVX2 rotateToWorld = Broadcast(glm::mat4(container.Rotation));
+	const __m256 low = _mm256_set1_ps(-0.5f);
+	const __m256 high = _mm256_set1_ps(0.5f);
+
+	uint32_t i = begin;
+	for (; i + 8 <= end; i += 8) {
+		__m256 px = _mm256_loadu_ps(&props.PositionX[i]);
+		__m256 py = _mm256_loadu_ps(&props.PositionY[i]);
+		__m256 pz = _mm256_loadu_ps(&props.PositionZ[i]);
+		__m256 vx = _mm256_loadu_ps(&props.VelocityX[i]);
+		__m256 vy = _mm256_loadu_ps(&props.VelocityY[i]);
+		__m256 vz = _mm256_loadu_ps(&props.VelocityZ[i]);
+		Apply(toLocal, px, py, pz);
+		Apply(rotateToLocal, vx, vy, vz);
+
+		// the walls in the same order as the scalar version, each one sees the corrections of the previous ones
+		Bounce(py, vy, _mm256_and_ps(_mm256_cmp_ps(py, low, _CMP_LT_OQ), Across(px, pz)), -0.5f);
+		Bounce(py, vy, _mm256_and_ps(_mm256_cmp_ps(py, high, _CMP_GT_OQ), Across(px, pz)), 0.5f);
+		Bounce(px, vx, _mm256_and_ps(_mm256_cmp_ps(px, low, _CMP_LT_OQ), Across(py, pz)), -0.5f);
+		Bounce(px, vx, _mm256_and_ps(_mm256_cmp_ps(px, high, _CMP_GT_OQ), Across(py, pz)), 0.5f);
+		Bounce(pz, vz, _mm256_and_ps(_mm256_cmp_ps(pz, low, _CMP_LT_OQ), Across(py, px)), -0.5f);
+		Bounce(pz, vz, _mm256_and_ps(_mm256_cmp_ps(pz, high, _CMP_GT_OQ), Across(py, px)), 0.5f);
+
+		Apply(toWorld, px, py, pz);
+		Apply(rotateToWorld, vx, vy, vz);
+		_mm256_storeu_ps(&props.PositionX[i], px);
+		_mm256_storeu_ps(&props.PositionY[i], py);
+		_mm256_storeu_ps(&props.PositionZ[i], pz);
+		_mm256_storeu_ps(&props.VelocityX[i], vx);
+		_mm256_storeu_ps(&props.VelocityY[i], vy);
+		_mm256_storeu_ps(&props.VelocityZ[i], vz);
+	}
+
+	SolverKernels::ResolveCollisionsScalar(container, props, i, end);
+}
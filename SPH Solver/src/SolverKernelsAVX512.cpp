@@ -0,0 +1,257 @@
+#include "SolverKernels.h"
+
+#include <immintrin.h>
+
+// compiled with AVX-512 enabled, only ever called when the processor supports it
+// the same loops as the AVX2 version, 16 molecules at a time with mask registers instead of blends
+
+// the unmasked forms of these intrinsics pass an uninitialised placeholder that trips -Wuninitialized on GCC 12,
+// the zero-masked forms with every lane set compile to the same instructions
+static inline __m512 Sqrt(__m512 v)
+{
+	return _mm512_maskz_sqrt_ps(0xffff, v);
+}
+
+static inline __m512i FloorToInt(__m512 v)
+{
+	return _mm512_maskz_cvt_roundps_epi32(0xffff, v, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+}
+
+// the four 128 bit lanes are added and summed like the AVX2 version, only needs AVX-512F
+static inline float HorizontalSum(__m512 v)
+{
+	__m128 sum = _mm_add_ps(_mm_add_ps(_mm512_maskz_extractf32x4_ps(0xf, v, 0), _mm512_maskz_extractf32x4_ps(0xf, v, 1)),
+		_mm_add_ps(_mm512_maskz_extractf32x4_ps(0xf, v, 2), _mm512_maskz_extractf32x4_ps(0xf, v, 3)));
+	sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+	sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+	return _mm_cvtss_f32(sum);
+}
+
+void SolverKernels::AccumulateDensityAVX512(const SolverKernels::Constants& c, const SPHSolver::MoleculeProperties& props,
+	uint32_t self, uint32_t begin, uint32_t end, float& density, float& nearDensity)
+{
+	const __m512 px = _mm512_set1_ps(props.PredictedX[self]);
+	const __m512 py = _mm512_set1_ps(props.PredictedY[self]);
+	const __m512 pz = _mm512_set1_ps(props.PredictedZ[self]);
+	const __m512 radius = _mm512_set1_ps(c.Radius);
+	const __m512i lanes = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+	const __m512i selfIndex = _mm512_set1_epi32((int)self);
+	__m512 sum = _mm512_setzero_ps();
+	__m512 nearSum = _mm512_setzero_ps();
+
+	uint32_t j = begin;
+	for (; j + 16 <= end; j += 16) {
+		__m512 dx = _mm512_sub_ps(px, _mm512_loadu_ps(&props.PredictedX[j]));
+		__m512 dy = _mm512_sub_ps(py, _mm512_loadu_ps(&props.PredictedY[j]));
+		__m512 dz = _mm512_sub_ps(pz, _mm512_loadu_ps(&props.PredictedZ[j]));
+		__m512 distance = Sqrt(_mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(dx, dx), _mm512_mul_ps(dy, dy)), _mm512_mul_ps(dz, dz)));
+
+		// candidates outside of the radius and the molecule itself contribute nothing
+		__mmask16 inside = _mm512_cmp_ps_mask(distance, radius, _CMP_LE_OQ);
+		inside &= ~_mm512_cmpeq_epi32_mask(_mm512_add_epi32(_mm512_set1_epi32((int)j), lanes), selfIndex);
+		__m512 difference = _mm512_maskz_sub_ps(inside, radius, distance);
+
+		__m512 difference3 = _mm512_mul_ps(_mm512_mul_ps(difference, difference), difference);
+		sum = _mm512_add_ps(sum, difference3);
+		nearSum = _mm512_add_ps(nearSum, _mm512_mul_ps(difference3, difference));
+	}
+
+	density += c.Mass * c.Scale * HorizontalSum(sum);
+	nearDensity += c.Mass * c.NearScale * HorizontalSum(nearSum);
+	SolverKernels::AccumulateDensityScalar(c, props, self, j, end, density, nearDensity);
+}
+
+void SolverKernels::AccumulateForceAVX512(const SolverKernels::Constants& c, const SPHSolver::MoleculeProperties& props,
+	uint32_t self, uint32_t begin, uint32_t end, glm::vec3& force)
+{
+	if (props.Density[self] < 0.01f) {
+		return;
+	}
+	const __m512 px = _mm512_set1_ps(props.PredictedX[self]);
+	const __m512 py = _mm512_set1_ps(props.PredictedY[self]);
+	const __m512 pz = _mm512_set1_ps(props.PredictedZ[self]);
+	const __m512 vx = _mm512_set1_ps(props.VelocityX[self]);
+	const __m512 vy = _mm512_set1_ps(props.VelocityY[self]);
+	const __m512 vz = _mm512_set1_ps(props.VelocityZ[self]);
+	const __m512 pressure = _mm512_set1_ps(props.Pressure[self]);
+	const __m512 nearPressure = _mm512_set1_ps(props.NearPressure[self]);
+	const __m512 radius = _mm512_set1_ps(c.Radius);
+	const __m512 minDensity = _mm512_set1_ps(0.01f);
+	const __m512 minLength = _mm512_set1_ps(0.00001f);
+	// -aux * slope * m folds into 3/2 m s (h - r)^2 (Pi + Pj) / rho_j, and 2 m s_near (h - r)^3 for the near pressure
+	const __m512 pressureScale = _mm512_set1_ps(1.5f * c.Mass * c.Scale);
+	const __m512 nearPressureScale = _mm512_set1_ps(2.0f * c.Mass * c.NearScale);
+	const __m512 viscosityScale = _mm512_set1_ps(c.Viscosity * c.Mass);
+	__m512 fx = _mm512_setzero_ps();
+	__m512 fy = _mm512_setzero_ps();
+	__m512 fz = _mm512_setzero_ps();
+
+	uint32_t j = begin;
+	for (; j + 16 <= end; j += 16) {
+		__m512 rho = _mm512_loadu_ps(&props.Density[j]);
+		__m512 nearRho = _mm512_loadu_ps(&props.NearDensity[j]);
+		__m512 dx = _mm512_sub_ps(px, _mm512_loadu_ps(&props.PredictedX[j]));
+		__m512 dy = _mm512_sub_ps(py, _mm512_loadu_ps(&props.PredictedY[j]));
+		__m512 dz = _mm512_sub_ps(pz, _mm512_loadu_ps(&props.PredictedZ[j]));
+		__m512 length = Sqrt(_mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(dx, dx), _mm512_mul_ps(dy, dy)), _mm512_mul_ps(dz, dz)));
+
+		// the same early exits as the scalar loop, as a lane mask
+		__mmask16 valid = _mm512_cmp_ps_mask(rho, minDensity, _CMP_GE_OQ) & _mm512_cmp_ps_mask(nearRho, minDensity, _CMP_GE_OQ);
+		valid &= _mm512_cmp_ps_mask(length, minLength, _CMP_GE_OQ) & _mm512_cmp_ps_mask(length, radius, _CMP_LE_OQ);
+
+		__m512 difference = _mm512_sub_ps(radius, length);
+		__m512 difference2 = _mm512_mul_ps(difference, difference);
+		__m512 pressureTerm = _mm512_div_ps(_mm512_mul_ps(_mm512_mul_ps(pressureScale, difference2), _mm512_add_ps(pressure, _mm512_loadu_ps(&props.Pressure[j]))), rho);
+		__m512 nearPressureTerm = _mm512_div_ps(_mm512_mul_ps(_mm512_mul_ps(nearPressureScale, _mm512_mul_ps(difference2, difference)), _mm512_add_ps(nearPressure, _mm512_loadu_ps(&props.NearPressure[j]))), nearRho);
+		// the masked lanes are zeroed, so their inf or nan never reaches the sums
+		__m512 coefficient = _mm512_maskz_div_ps(valid, _mm512_add_ps(pressureTerm, nearPressureTerm), length);
+		fx = _mm512_add_ps(fx, _mm512_mul_ps(coefficient, dx));
+		fy = _mm512_add_ps(fy, _mm512_mul_ps(coefficient, dy));
+		fz = _mm512_add_ps(fz, _mm512_mul_ps(coefficient, dz));
+
+		// apply viscosity, unless the velocities are too close to get a direction
+		__m512 dvx = _mm512_sub_ps(_mm512_loadu_ps(&props.VelocityX[j]), vx);
+		__m512 dvy = _mm512_sub_ps(_mm512_loadu_ps(&props.VelocityY[j]), vy);
+		__m512 dvz = _mm512_sub_ps(_mm512_loadu_ps(&props.VelocityZ[j]), vz);
+		__m512 speed = Sqrt(_mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(dvx, dvx), _mm512_mul_ps(dvy, dvy)), _mm512_mul_ps(dvz, dvz)));
+		__mmask16 moving = valid & _mm512_cmp_ps_mask(speed, minLength, _CMP_GE_OQ);
+		coefficient = _mm512_maskz_div_ps(moving, viscosityScale, _mm512_mul_ps(rho, speed));
+		fx = _mm512_add_ps(fx, _mm512_mul_ps(coefficient, dvx));
+		fy = _mm512_add_ps(fy, _mm512_mul_ps(coefficient, dvy));
+		fz = _mm512_add_ps(fz, _mm512_mul_ps(coefficient, dvz));
+	}
+
+	force += glm::vec3(HorizontalSum(fx), HorizontalSum(fy), HorizontalSum(fz));
+	SolverKernels::AccumulateForceScalar(c, props, self, j, end, force);
+}
+
+void SolverKernels::ComputeCellKeysAVX512(const SolverKernels::CellKeyParams& params, const SPHSolver::MoleculeProperties& props,
+	uint32_t begin, uint32_t end, uint32_t* keys)
+{
+	const __m512 cellSize = _mm512_set1_ps(params.CellSize);
+	const int localZ = -params.GridOrigin.z;
+	uint32_t i = begin;
+
+	if (!params.Dense) {
+		const __m512i primeX = _mm512_set1_epi32(73856093);
+		const __m512i primeY = _mm512_set1_epi32(19349663);
+		for (; i + 16 <= end; i += 16) {
+			// the division is kept, a multiplication by the inverse could snap to another cell on the borders
+			__m512i x = FloorToInt(_mm512_div_ps(_mm512_loadu_ps(&props.PredictedX[i]), cellSize));
+			__m512i y = FloorToInt(_mm512_div_ps(_mm512_loadu_ps(&props.PredictedY[i]), cellSize));
+			_mm512_storeu_si512(&keys[i], _mm512_xor_si512(_mm512_mullo_epi32(x, primeX), _mm512_mullo_epi32(y, primeY)));
+			// there is no vector integer division, so the modulo stays scalar
+			for (uint32_t k = i; k < i + 16; k++) {
+				keys[k] %= params.HashSize;
+			}
+		}
+	}
+	else if (localZ >= 0 && localZ < params.GridSize.z) {
+		const __m512i originX = _mm512_set1_epi32(params.GridOrigin.x);
+		const __m512i originY = _mm512_set1_epi32(params.GridOrigin.y);
+		const __m512i sizeX = _mm512_set1_epi32(params.GridSize.x);
+		const __m512i sizeY = _mm512_set1_epi32(params.GridSize.y);
+		const __m512i layer = _mm512_set1_epi32(localZ * params.GridSize.y);
+		const __m512i outside = _mm512_set1_epi32((int)params.OutsideSlot);
+		const __m512i zero = _mm512_setzero_si512();
+		for (; i + 16 <= end; i += 16) {
+			__m512i x = _mm512_sub_epi32(FloorToInt(_mm512_div_ps(_mm512_loadu_ps(&props.PredictedX[i]), cellSize)), originX);
+			__m512i y = _mm512_sub_epi32(FloorToInt(_mm512_div_ps(_mm512_loadu_ps(&props.PredictedY[i]), cellSize)), originY);
+			__mmask16 inside = _mm512_cmpge_epi32_mask(x, zero) & _mm512_cmplt_epi32_mask(x, sizeX);
+			inside &= _mm512_cmpge_epi32_mask(y, zero) & _mm512_cmplt_epi32_mask(y, sizeY);
+			__m512i index = _mm512_add_epi32(_mm512_mullo_epi32(_mm512_add_epi32(layer, y), sizeX), x);
+			_mm512_storeu_si512(&keys[i], _mm512_mask_blend_epi32(inside, outside, index));
+		}
+	}
+
+	// the tail, and the whole range when the flat grid lies outside of the dense one
+	SolverKernels::ComputeCellKeysScalar(params, props, i, end, keys);
+}
+
+// the columns of an affine matrix, the last one being the translation
+struct AffineAVX512
+{
+	__m512 Column[4][3];
+};
+
+static inline AffineAVX512 Broadcast(const glm::mat4& m)
+{
+	AffineAVX512 result;
+	for (int column = 0; column < 4; column++) {
+		for (int row = 0; row < 3; row++) {
+			result.Column[column][row] = _mm512_set1_ps(m[column][row]);
+		}
+	}
+	return result;
+}
+
+static inline void Apply(const AffineAVX512& m, __m512& x, __m512& y, __m512& z)
+{
+	__m512 rx = _mm512_add_ps(_mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(m.Column[0][0], x), _mm512_mul_ps(m.Column[1][0], y)), _mm512_mul_ps(m.Column[2][0], z)), m.Column[3][0]);
+	__m512 ry = _mm512_add_ps(_mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(m.Column[0][1], x), _mm512_mul_ps(m.Column[1][1], y)), _mm512_mul_ps(m.Column[2][1], z)), m.Column[3][1]);
+	__m512 rz = _mm512_add_ps(_mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(m.Column[0][2], x), _mm512_mul_ps(m.Column[1][2], y)), _mm512_mul_ps(m.Column[2][2], z)), m.Column[3][2]);
+	x = rx;
+	y = ry;
+	z = rz;
+}
+
+// set where both coordinates are inside the wall's extent
+static inline __mmask16 Across(__m512 a, __m512 b)
+{
+	const __m512 low = _mm512_set1_ps(-0.6f);
+	const __m512 high = _mm512_set1_ps(0.6f);
+	return _mm512_cmp_ps_mask(a, low, _CMP_GT_OQ) & _mm512_cmp_ps_mask(a, high, _CMP_LT_OQ)
+		& _mm512_cmp_ps_mask(b, low, _CMP_GT_OQ) & _mm512_cmp_ps_mask(b, high, _CMP_LT_OQ);
+}
+
+// puts the molecules that went through the wall back on it and reflects their velocity
+static inline void Bounce(__m512& position, __m512& velocity, __mmask16 hit, float wall)
+{
+	velocity = _mm512_mask_mul_ps(velocity, hit, _mm512_set1_ps(-0.5f), velocity);
+	position = _mm512_mask_blend_ps(hit, position, _mm512_set1_ps(wall));
+}
+
+void SolverKernels::ResolveCollisionsAVX512(const CollisionSolver::ContainerState& container, SPHSolver::MoleculeProperties& props,
+	uint32_t begin, uint32_t end)
+{
+	if (container.Degenerate) {
+		return;
+	}
+	const AffineAVX512 toLocal = Broadcast(container.InverseTransform);
+	const AffineAVX512 toWorld = Broadcast(container.Transform);
+	const AffineAVX512 rotateToLocal = Broadcast(glm::mat4(container.InverseRotation));
+	const AffineAVX512 rotateToWorld = Broadcast(glm::mat4(container.Rotation));
+	const __m512 low = _mm512_set1_ps(-0.5f);
+	const __m512 high = _mm512_set1_ps(0.5f);
+
+	uint32_t i = begin;
+	for (; i + 16 <= end; i += 16) {
+		__m512 px = _mm512_loadu_ps(&props.PositionX[i]);
+		__m512 py = _mm512_loadu_ps(&props.PositionY[i]);
+		__m512 pz = _mm512_loadu_ps(&props.PositionZ[i]);
+		__m512 vx = _mm512_loadu_ps(&props.VelocityX[i]);
+		__m512 vy = _mm512_loadu_ps(&props.VelocityY[i]);
+		__m512 vz = _mm512_loadu_ps(&props.VelocityZ[i]);
+		Apply(toLocal, px, py, pz);
+		Apply(rotateToLocal, vx, vy, vz);
+
+		// the walls in the same order as the scalar version, each one sees the corrections of the previous ones
+		Bounce(py, vy, _mm512_cmp_ps_mask(py, low, _CMP_LT_OQ) & Across(px, pz), -0.5f);
+		Bounce(py, vy, _mm512_cmp_ps_mask(py, high, _CMP_GT_OQ) & Across(px, pz), 0.5f);
+		Bounce(px, vx, _mm512_cmp_ps_mask(px, low, _CMP_LT_OQ) & Across(py, pz), -0.5f);
+		Bounce(px, vx, _mm512_cmp_ps_mask(px, high, _CMP_GT_OQ) & Across(py, pz), 0.5f);
+		Bounce(pz, vz, _mm512_cmp_ps_mask(pz, low, _CMP_LT_OQ) & Across(py, px), -0.5f);
+		Bounce(pz, vz, _mm512_cmp_ps_mask(pz, high, _CMP_GT_OQ) & Across(py, px), 0.5f);
+
+		Apply(toWorld, px, py, pz);
+		Apply(rotateToWorld, vx, vy, vz);
+		_mm512_storeu_ps(&props.PositionX[i], px);
+		_mm512_storeu_ps(&props.PositionY[i], py);
+		_mm512_storeu_ps(&props.PositionZ[i], pz);
+		_mm512_storeu_ps(&props.VelocityX[i], vx);
+		_mm512_storeu_ps(&props.VelocityY[i], vy);
+		_mm512_storeu_ps(&props.VelocityZ[i], vz);
+	}
+
+	SolverKernels::ResolveCollisionsScalar(container, props, i, end);
+}
@@ -0,0 +1,243 @@
+#include "SolverKernels.h"
+
+#include <nmmintrin.h>
+
+// the same loops as the AVX2 version, 4 molecules at a time
+
+static inline float HorizontalSum(__m128 v)
+{
+	__m128 sum = _mm_add_ps(v, _mm_movehl_ps(v, v));
+	sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+	return _mm_cvtss_f32(sum);
+}
+
+void SolverKernels::AccumulateDensitySSE42(const SolverKernels::Constants& c, const SPHSolver::MoleculeProperties& props,
+	uint32_t self, uint32_t begin, uint32_t end, float& density, float& nearDensity)
+{
+	const __m128 px = _mm_set1_ps(props.PredictedX[self]);
+	const __m128 py = _mm_set1_ps(props.PredictedY[self]);
+	const __m128 pz = _mm_set1_ps(props.PredictedZ[self]);
+	const __m128 radius = _mm_set1_ps(c.Radius);
+	const __m128i lanes = _mm_setr_epi32(0, 1, 2, 3);
+	const __m128i selfIndex = _mm_set1_epi32((int)self);
+	__m128 sum = _mm_setzero_ps();
+	__m128 nearSum = _mm_setzero_ps();
+
+	uint32_t j = begin;
+	for (; j + 4 <= end; j += 4) {
+		__m128 dx = _mm_sub_ps(px, _mm_loadu_ps(&props.PredictedX[j]));
+		__m128 dy = _mm_sub_ps(py, _mm_loadu_ps(&props.PredictedY[j]));
+		__m128 dz = _mm_sub_ps(pz, _mm_loadu_ps(&props.PredictedZ[j]));
+		__m128 distance = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+
+		// candidates outside of the radius and the molecule itself contribute nothing
+		__m128 inside = _mm_cmple_ps(distance, radius);
+		__m128 isSelf = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_add_epi32(_mm_set1_epi32((int)j), lanes), selfIndex));
+		__m128 difference = _mm_and_ps(_mm_andnot_ps(isSelf, inside), _mm_sub_ps(radius, distance));
+
+		__m128 difference3 = _mm_mul_ps(_mm_mul_ps(difference, difference), difference);
+		sum = _mm_add_ps(sum, difference3);
+		nearSum = _mm_add_ps(nearSum, _mm_mul_ps(difference3, difference));
+	}
+
+	density += c.Mass * c.Scale * HorizontalSum(sum);
+	nearDensity += c.Mass * c.NearScale * HorizontalSum(nearSum);
+	SolverKernels::AccumulateDensityScalar(c, props, self, j, end, density, nearDensity);
+}
+
+void SolverKernels::AccumulateForceSSE42(const SolverKernels::Constants& c, const SPHSolver::MoleculeProperties& props,
+	uint32_t self, uint32_t begin, uint32_t end, glm::vec3& force)
+{
+	if (props.Density[self] < 0.01f) {
+		return;
+	}
+	const __m128 px = _mm_set1_ps(props.PredictedX[self]);
+	const __m128 py = _mm_set1_ps(props.PredictedY[self]);
+	const __m128 pz = _mm_set1_ps(props.PredictedZ[self]);
+	const __m128 vx = _mm_set1_ps(props.VelocityX[self]);
+	const __m128 vy = _mm_set1_ps(props.VelocityY[self]);
+	const __m128 vz = _mm_set1_ps(props.VelocityZ[self]);
+	const __m128 pressure = _mm_set1_ps(props.Pressure[self]);
+	const __m128 nearPressure = _mm_set1_ps(props.NearPressure[self]);
+	const __m128 radius = _mm_set1_ps(c.Radius);
+	const __m128 minDensity = _mm_set1_ps(0.01f);
+	const __m128 minLength = _mm_set1_ps(0.00001f);
+	// -aux * slope * m folds into 3/2 m s (h - r)^2 (Pi + Pj) / rho_j, and 2 m s_near (h - r)^3 for the near pressure
+	const __m128 pressureScale = _mm_set1_ps(1.5f * c.Mass * c.Scale);
+	const __m128 nearPressureScale = _mm_set1_ps(2.0f * c.Mass * c.NearScale);
+	const __m128 viscosityScale = _mm_set1_ps(c.Viscosity * c.Mass);
+	__m128 fx = _mm_setzero_ps();
+	__m128 fy = _mm_setzero_ps();
+	__m128 fz = _mm_setzero_ps();
+
+	uint32_t j = begin;
+	for (; j + 4 <= end; j += 4) {
+		__m128 rho = _mm_loadu_ps(&props.Density[j]);
+		__m128 nearRho = _mm_loadu_ps(&props.NearDensity[j]);
+		__m128 dx = _mm_sub_ps(px, _mm_loadu_ps(&props.PredictedX[j]));
+		__m128 dy = _mm_sub_ps(py, _mm_loadu_ps(&props.PredictedY[j]));
+		__m128 dz = _mm_sub_ps(pz, _mm_loadu_ps(&props.PredictedZ[j]));
+		__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+
+		// the same early exits as the scalar loop, as a lane mask
+		__m128 valid = _mm_and_ps(_mm_cmpge_ps(rho, minDensity), _mm_cmpge_ps(nearRho, minDensity));
+		valid = _mm_and_ps(valid, _mm_cmpge_ps(length, minLength));
+		valid = _mm_and_ps(valid, _mm_cmple_ps(length, radius));
+
+		__m128 difference = _mm_sub_ps(radius, length);
+		__m128 difference2 = _mm_mul_ps(difference, difference);
+		__m128 pressureTerm = _mm_div_ps(_mm_mul_ps(_mm_mul_ps(pressureScale, difference2), _mm_add_ps(pressure, _mm_loadu_ps(&props.Pressure[j]))), rho);
+		__m128 nearPressureTerm = _mm_div_ps(_mm_mul_ps(_mm_mul_ps(nearPressureScale, _mm_mul_ps(difference2, difference)), _mm_add_ps(nearPressure, _mm_loadu_ps(&props.NearPressure[j]))), nearRho);
+		// the masked lanes may hold inf or nan, clearing the bits removes them
+		__m128 coefficient = _mm_and_ps(valid, _mm_div_ps(_mm_add_ps(pressureTerm, nearPressureTerm), length));
+		fx = _mm_add_ps(fx, _mm_mul_ps(coefficient, dx));
+		fy = _mm_add_ps(fy, _mm_mul_ps(coefficient, dy));
+		fz = _mm_add_ps(fz, _mm_mul_ps(coefficient, dz));
+
+		// apply viscosity, unless the velocities are too close to get a direction
+		__m128 dvx = _mm_sub_ps(_mm_loadu_ps(&props.VelocityX[j]), vx);
+		__m128 dvy = _mm_sub_ps(_mm_loadu_ps(&props.VelocityY[j]), vy);
+		__m128 dvz = _mm_sub_ps(_mm_loadu_ps(&props.VelocityZ[j]), vz);
+		__m128 speed = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dvx, dvx), _mm_mul_ps(dvy, dvy)), _mm_mul_ps(dvz, dvz)));
+		__m128 moving = _mm_and_ps(valid, _mm_cmpge_ps(speed, minLength));
+		coefficient = _mm_and_ps(moving, _mm_div_ps(viscosityScale, _mm_mul_ps(rho, speed)));
+		fx = _mm_add_ps(fx, _mm_mul_ps(coefficient, dvx));
+		fy = _mm_add_ps(fy, _mm_mul_ps(coefficient, dvy));
+		fz = _mm_add_ps(fz, _mm_mul_ps(coefficient, dvz));
+	}
+
+	force += glm::vec3(HorizontalSum(fx), HorizontalSum(fy), HorizontalSum(fz));
+	SolverKernels::AccumulateForceScalar(c, props, self, j, end, force);
+}
+
+void SolverKernels::ComputeCellKeysSSE42(const SolverKernels::CellKeyParams& params, const SPHSolver::MoleculeProperties& props,
+	uint32_t begin, uint32_t end, uint32_t* keys)
+{
+	const __m128 cellSize = _mm_set1_ps(params.CellSize);
+	const int localZ = -params.GridOrigin.z;
+	uint32_t i = begin;
+
+	if (!params.Dense) {
+		const __m128i primeX = _mm_set1_epi32(73856093);
+		const __m128i primeY = _mm_set1_epi32(19349663);
+		for (; i + 4 <= end; i += 4) {
+			// the division is kept, a multiplication by the inverse could snap to another cell on the borders
+			__m128i x = _mm_cvttps_epi32(_mm_floor_ps(_mm_div_ps(_mm_loadu_ps(&props.PredictedX[i]), cellSize)));
+			__m128i y = _mm_cvttps_epi32(_mm_floor_ps(_mm_div_ps(_mm_loadu_ps(&props.PredictedY[i]), cellSize)));
+			_mm_storeu_si128((__m128i*)&keys[i], _mm_xor_si128(_mm_mullo_epi32(x, primeX), _mm_mullo_epi32(y, primeY)));
+			// there is no vector integer division, so the modulo stays scalar
+			for (uint32_t k = i; k < i + 4; k++) {
+				keys[k] %= params.HashSize;
+			}
+		}
+	}
+	else if (localZ >= 0 && localZ < params.GridSize.z) {
+		const __m128i originX = _mm_set1_epi32(params.GridOrigin.x);
+		const __m128i originY = _mm_set1_epi32(params.GridOrigin.y);
+		const __m128i sizeX = _mm_set1_epi32(params.GridSize.x);
+		const __m128i sizeY = _mm_set1_epi32(params.GridSize.y);
+		const __m128i layer = _mm_set1_epi32(localZ * params.GridSize.y);
+		const __m128i outside = _mm_set1_epi32((int)params.OutsideSlot);
+		const __m128i minusOne = _mm_set1_epi32(-1);
+		for (; i + 4 <= end; i += 4) {
+			__m128i x = _mm_sub_epi32(_mm_cvttps_epi32(_mm_floor_ps(_mm_div_ps(_mm_loadu_ps(&props.PredictedX[i]), cellSize))), originX);
+			__m128i y = _mm_sub_epi32(_mm_cvttps_epi32(_mm_floor_ps(_mm_div_ps(_mm_loadu_ps(&props.PredictedY[i]), cellSize))), originY);
+			__m128i inside = _mm_and_si128(_mm_cmpgt_epi32(x, minusOne), _mm_cmpgt_epi32(sizeX, x));
+			inside = _mm_and_si128(inside, _mm_and_si128(_mm_cmpgt_epi32(y, minusOne), _mm_cmpgt_epi32(sizeY, y)));
+			__m128i index = _mm_add_epi32(_mm_mullo_epi32(_mm_add_epi32(layer, y), sizeX), x);
+			_mm_storeu_si128((__m128i*)&keys[i], _mm_blendv_epi8(outside, index, inside));
+		}
+	}
+
+	// the tail, and the whole range when the flat grid lies outside of the dense one
+	SolverKernels::ComputeCellKeysScalar(params, props, i, end, keys);
+}
+
+// the columns of an affine matrix, the last one being the translation
+struct AffineSSE42
+{
+	__m128 Column[4][3];
+};
+
+static inline AffineSSE42 Broadcast(const glm::mat4& m)
+{
+	AffineSSE42 result;
+	for (int column = 0; column < 4; column++) {
+		for (int row = 0; row < 3; row++) {
+			result.Column[column][row] = _mm_set1_ps(m[column][row]);
+		}
+	}
+	return result;
+}
+
+static inline void Apply(const AffineSSE42& m, __m128& x, __m128& y, __m128& z)
+{
+	__m128 rx = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m.Column[0][0], x), _mm_mul_ps(m.Column[1][0], y)), _mm_mul_ps(m.Column[2][0], z)), m.Column[3][0]);
+	__m128 ry = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m.Column[0][1], x), _mm_mul_ps(m.Column[1][1], y)), _mm_mul_ps(m.Column[2][1], z)), m.Column[3][1]);
+	__m128 rz = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m.Column[0][2], x), _mm_mul_ps(m.Column[1][2], y)), _mm_mul_ps(m.Column[2][2], z)), m.Column[3][2]);
+	x = rx;
+	y = ry;
+	z = rz;
+}
+
+// set where both coordinates are inside the wall's extent
+static inline __m128 Across(__m128 a, __m128 b)
+{
+	const __m128 low = _mm_set1_ps(-0.6f);
+	const __m128 high = _mm_set1_ps(0.6f);
+	__m128 acrossA = _mm_and_ps(_mm_cmpgt_ps(a, low), _mm_cmplt_ps(a, high));
+	__m128 acrossB = _mm_and_ps(_mm_cmpgt_ps(b, low), _mm_cmplt_ps(b, high));
+	return _mm_and_ps(acrossA, acrossB);
+}
+
+// puts the molecules that went through the wall back on it and reflects their velocity
+static inline void Bounce(__m128& position, __m128& velocity, __m128 hit, float wall)
+{
+	velocity = _mm_blendv_ps(velocity, _mm_mul_ps(_mm_set1_ps(-0.5f), velocity), hit);
+	position = _mm_blendv_ps(position, _mm_set1_ps(wall), hit);
+}
+
+void SolverKernels::ResolveCollisionsSSE42(const CollisionSolver::ContainerState& container, SPHSolver::MoleculeProperties& props,
+	uint32_t begin, uint32_t end)
+{
+	if (container.Degenerate) {
+		return;
+	}
+	const AffineSSE42 toLocal = Broadcast(container.InverseTransform);
+	const AffineSSE42 toWorld = Broadcast(container.Transform);
+	const AffineSSE42 rotateToLocal = Broadcast(glm::mat4(container.InverseRotation));
+	const AffineSSE42 rotateToWorld = Broadcast(glm::mat4(container.Rotation));
+	const __m128 low = _mm_set1_ps(-0.5f);
+	const __m128 high = _mm_set1_ps(0.5f);
+
+	uint32_t i = begin;
+	for (; i + 4 <= end; i += 4) {
+		__m128 px = _mm_loadu_ps(&props.PositionX[i]);
+		__m128 py = _mm_loadu_ps(&props.PositionY[i]);
+		__m128 pz = _mm_loadu_ps(&props.PositionZ[i]);
+		__m128 vx = _mm_loadu_ps(&props.VelocityX[i]);
+		__m128 vy = _mm_loadu_ps(&props.VelocityY[i]);
+		__m128 vz = _mm_loadu_ps(&props.VelocityZ[i]);
+		Apply(toLocal, px, py, pz);
+		Apply(rotateToLocal, vx, vy, vz);
+
+		// the walls in the same order as the scalar version, each one sees the corrections of the previous ones
+		Bounce(py, vy, _mm_and_ps(_mm_cmplt_ps(py, low), Across(px, pz)), -0.5f);
+		Bounce(py, vy, _mm_and_ps(_mm_cmpgt_ps(py, high), Across(px, pz)), 0.5f);
+		Bounce(px, vx, _mm_and_ps(_mm_cmplt_ps(px, low), Across(py, pz)), -0.5f);
+		Bounce(px, vx, _mm_and_ps(_mm_cmpgt_ps(px, high), Across(py, pz)), 0.5f);
+		Bounce(pz, vz, _mm_and_ps(_mm_cmplt_ps(pz, low), Across(py, px)), -0.5f);
+		Bounce(pz, vz, _mm_and_ps(_mm_cmpgt_ps(pz, high), Across(py, px)), 0.5f);
+
+		Apply(toWorld, px, py, pz);
+		Apply(rotateToWorld, vx, vy, vz);
+		_mm_storeu_ps(&props.PositionX[i], px);
+		_mm_storeu_ps(&props.PositionY[i], py);
+		_mm_storeu_ps(&props.PositionZ[i], pz);
+		_mm_storeu_ps(&props.VelocityX[i], vx);
+		_mm_storeu_ps(&props.VelocityY[i], vy);
+		_mm_storeu_ps(&props.VelocityZ[i], vz);
+	}
+
+	SolverKernels::ResolveCollisionsScalar(container, props, i, end);
+}
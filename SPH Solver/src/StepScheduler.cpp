@@ -0,0 +1,72 @@
+#include "StepScheduler.h"
+
+#include <chrono>
+#include <cmath>
+
+static struct SchedulerData
+{
+	float TimeStep = 0.001666f;
+	float Budget = 12.0f;  // in milliseconds
+	float Accumulator = 0.0f;  // elapsed time that was not simulated yet
+	StepScheduler::Statistics Stats = {};
+} Tdata;
+
+void StepScheduler::SetTimeStep(float dt)
+{
+	Tdata.TimeStep = dt;
+}
+
+void StepScheduler::SetBudget(float milliseconds)
+{
+	Tdata.Budget = milliseconds;
+}
+
+uint32_t StepScheduler::Advance(float elapsed, const StepScheduler::Step& step)
+{
+	using Clock = std::chrono::steady_clock;
+	Tdata.Accumulator += elapsed;
+
+	const Clock::time_point start = Clock::now();
+	double spent = 0.0;
+	double lastStep = 0.0;
+	uint32_t steps = 0;
+	while (Tdata.Accumulator >= Tdata.TimeStep) {
+		// stop before the next step would cross the budget, assuming it costs as much as the previous one
+		if (steps > 0 && spent + lastStep > Tdata.Budget) {
+			break;
+		}
+		step(Tdata.TimeStep);
+		Tdata.Accumulator -= Tdata.TimeStep;
+		steps++;
+
+		const double now = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		lastStep = now - spent;
+		spent = now;
+	}
+
+	// whatever is still due could not be afforded, carrying it over would only make the next frame slower
+	// the part smaller than one step stays, so the step rate does not jitter
+	float dropped = 0.0f;
+	if (Tdata.Accumulator >= Tdata.TimeStep) {
+		const float remainder = std::fmod(Tdata.Accumulator, Tdata.TimeStep);
+		dropped = Tdata.Accumulator - remainder;
+		Tdata.Accumulator = remainder;
+	}
+
+	Tdata.Stats.Steps = steps;
+	Tdata.Stats.StepMilliseconds = steps > 0 ? (float)(spent / steps) : 0.0f;
+	Tdata.Stats.DroppedLastFrame = dropped;
+	Tdata.Stats.DroppedTotal += dropped;
+	return steps;
+}
+
+void StepScheduler::Reset()
+{
+	Tdata.Accumulator = 0.0f;
+	Tdata.Stats = {};
+}
+
+const StepScheduler::Statistics& StepScheduler::GetStatistics()
+{
+	return Tdata.Stats;
+}
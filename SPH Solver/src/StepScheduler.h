@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cinttypes>
+#include <functional>
+
+// turns the variable frame time into a whole number of fixed solver steps
+// the time that was not simulated yet is carried to the next frame, unless the steps ran over the budget
+class StepScheduler
+{
+public:
+	using Step = std::function<void(float dt)>;
+
+	struct Statistics
+	{
+		uint32_t Steps;           // the steps run by the last frame
+		float StepMilliseconds;   // the average wall time of one of them
+		float DroppedLastFrame;   // simulation time thrown away by the last frame, in seconds
+		double DroppedTotal;      // since the last reset, in seconds
+	};
+
+public:
+	static void SetTimeStep(float dt);
+	// the wall time the steps of one frame may take, at least one step runs when one is due
+	static void SetBudget(float milliseconds);
+
+	// adds the elapsed time and calls step(dt) until the backlog is smaller than one step or the budget is spent
+	static uint32_t Advance(float elapsed, const StepScheduler::Step& step);
+	// forgets the backlog and the statistics, used when the simulation is paused or reset
+	static void Reset();
+
+	static const StepScheduler::Statistics& GetStatistics();
+
+private:
+	StepScheduler() = default;
+
+};
@@ -0,0 +1,183 @@
+#include "ThreadPool.h"
+
+#include "AllocationCounter.h"
+#include "Tracer.h"
+
+#include <chrono>
+
+static thread_local uint32_t t_WorkerIndex = 0;
+
+static uint64_t NowNanoseconds()
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+ThreadPool::ThreadPool(uint32_t numThreads)
+	:
+	m_NumThreads(numThreads > 0 ? numThreads : 1),
+	m_BusyNanoseconds(m_NumThreads),
+	m_TaskNanoseconds(m_NumThreads),
+	m_BarrierNanoseconds(m_NumThreads)
+{
+	m_LastSample = NowNanoseconds();
+	// worker 0 is the thread that dispatches, so only the rest need spawning
+	for (uint32_t i = 1; i < m_NumThreads; i++) {
+		m_Threads.emplace_back(&ThreadPool::WorkerLoop, this, i);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Stop = true;
+	}
+	m_WakeCondition.notify_all();
+	for (auto& t : m_Threads) {
+		t.join();
+	}
+}
+
+void ThreadPool::Dispatch(const Task& task, const char* name)
+{
+	const uint64_t dispatchStart = NowNanoseconds();
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Task = &task;
+		m_TaskName = name;
+		m_Pending = m_NumThreads - 1;
+		m_Generation++;
+	}
+	m_WakeCondition.notify_all();
+
+	RunTask(0);
+
+	// wait for the other workers, this is the barrier at the end of every pass
+	const uint64_t waitStart = NowNanoseconds();
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	m_DoneCondition.wait(lock, [this]() { return m_Pending == 0; });
+	m_Task = nullptr;
+	m_DispatchEnd = NowNanoseconds();
+	Tracer::Record("Barrier wait", waitStart, m_DispatchEnd);
+
+	// whatever part of the dispatch a worker did not spend on its task, or spent in Barrier, it was idle
+	const uint64_t span = (m_DispatchEnd - dispatchStart) * m_NumThreads;
+	uint64_t working = 0;
+	for (uint32_t w = 0; w < m_NumThreads; w++) {
+		working += m_TaskNanoseconds[w] - std::min(m_BarrierNanoseconds[w], m_TaskNanoseconds[w]);
+		m_BarrierNanoseconds[w] = 0;
+	}
+	m_DispatchNanoseconds += span;
+	m_IdleNanoseconds += span - std::min(working, span);
+}
+
+void ThreadPool::Barrier()
+{
+	TraceScope trace("Barrier");
+	const uint64_t start = NowNanoseconds();
+	std::unique_lock<std::mutex> lock(m_BarrierMutex);
+	uint64_t generation = m_BarrierGeneration;
+	if (++m_BarrierCount == m_NumThreads) {
+		m_BarrierCount = 0;
+		m_BarrierGeneration++;
+		m_BarrierCondition.notify_all();
+		return;
+	}
+	m_BarrierCondition.wait(lock, [this, generation]() { return m_BarrierGeneration != generation; });
+	m_BarrierNanoseconds[t_WorkerIndex] += NowNanoseconds() - start;
+}
+
+void ThreadPool::SetGrainSize(uint32_t grain)
+{
+	m_GrainSize = grain;
+}
+
+uint32_t ThreadPool::GetChunkSize(uint32_t count) const
+{
+	uint32_t grain = m_GrainSize;
+	if (grain == 0) {
+		grain = (count + 8 * m_NumThreads - 1) / (8 * m_NumThreads);
+	}
+	return std::max((grain + 15u) & ~15u, 16u);
+}
+
+uint32_t ThreadPool::GetNumThreads() const
+{
+	return m_NumThreads;
+}
+
+float ThreadPool::SampleUtilisation()
+{
+	uint64_t now = NowNanoseconds();
+	uint64_t busy = 0;
+	for (auto& b : m_BusyNanoseconds) {
+		busy += b.exchange(0, std::memory_order_relaxed);
+	}
+	uint64_t elapsed = now - m_LastSample;
+	m_LastSample = now;
+	if (elapsed == 0) {
+		return 0.0f;
+	}
+	return (float)((double)busy / ((double)elapsed * m_NumThreads));
+}
+
+float ThreadPool::SampleBarrierIdle()
+{
+	const float idle = m_DispatchNanoseconds > 0 ? (float)((double)m_IdleNanoseconds / (double)m_DispatchNanoseconds) : 0.0f;
+	m_DispatchNanoseconds = 0;
+	m_IdleNanoseconds = 0;
+	return idle;
+}
+
+uint32_t ThreadPool::GetWorkerIndex()
+{
+	return t_WorkerIndex;
+}
+
+void ThreadPool::WorkerLoop(uint32_t worker)
+{
+	t_WorkerIndex = worker;
+	// registering allocates the ring, so it happens before the allocations are counted
+	Tracer::RegisterThread("Solver worker " + std::to_string(worker));
+	AllocationCounter::TrackCurrentThread();
+	uint64_t seenGeneration = 0;
+	uint64_t taskEnd = 0;
+	while (true) {
+		{
+			// park until there is new work or the pool shuts down
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_WakeCondition.wait(lock, [this, seenGeneration]() { return m_Stop || m_Generation != seenGeneration; });
+			// the end of the previous dispatch is only known now, so its wait is traced late
+			if (taskEnd != 0) {
+				Tracer::Record("Barrier wait", taskEnd, m_DispatchEnd);
+			}
+			if (m_Stop) {
+				return;
+			}
+			seenGeneration = m_Generation;
+		}
+
+		taskEnd = RunTask(worker);
+
+		bool last;
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			last = --m_Pending == 0;
+		}
+		if (last) {
+			m_DoneCondition.notify_one();
+		}
+	}
+}
+
+uint64_t ThreadPool::RunTask(uint32_t worker)
+{
+	uint64_t start = NowNanoseconds();
+	(*m_Task)(worker);
+	uint64_t end = NowNanoseconds();
+	m_BusyNanoseconds[worker].fetch_add(end - start, std::memory_order_relaxed);
+	m_TaskNanoseconds[worker] = end - start;
+	Tracer::Record(m_TaskName, start, end);
+	return end;
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Core.h"
+
+// long-lived pool of worker threads, parked on a condition variable between dispatches
+// the calling thread always takes part in the work as worker 0
+class ThreadPool
+{
+public:
+	using Task = std::function<void(uint32_t worker)>;
+
+public:
+	ThreadPool(uint32_t numThreads);
+	~ThreadPool();
+
+	// runs the task once on every worker and returns when all of them finished,
+	// so consecutive dispatches are separated by an implicit barrier
+	// the name labels the slice of every worker in the trace
+	void Dispatch(const Task& task, const char* name = "Task");
+
+	// calls body(i) for every i in [0, count), in contiguous chunks taken from a shared counter
+	// a worker that is done with its chunk takes the next one, so uneven costs balance themselves,
+	// and the chunks start on a cache line of the per-molecule arrays, so no two workers write the same one
+	template <typename Func>
+	void ParallelFor(uint32_t count, Func&& body, const char* name = "Task")
+	{
+		// the task only captures two pointers, so the std::function keeps it inline instead of on the heap
+		struct Chunks
+		{
+			Func& Body;
+			uint32_t Count;
+			uint32_t Grain;
+		} chunks = { body, count, GetChunkSize(count) };
+		m_NextChunk.store(0, std::memory_order_relaxed);
+		Dispatch([this, &chunks](uint32_t /*worker*/) {
+			while (true) {
+				const uint32_t begin = m_NextChunk.fetch_add(chunks.Grain, std::memory_order_relaxed);
+				if (begin >= chunks.Count) {
+					return;
+				}
+				const uint32_t end = std::min(begin + chunks.Grain, chunks.Count);
+				for (uint32_t i = begin; i < end; i++) {
+					chunks.Body(i);
+				}
+			}
+		}, name);
+	}
+
+	// calls body(i) for every i in [bounds[w], bounds[w + 1]) on worker w, for splits the caller computed
+	template <typename Func>
+	void ParallelRanges(const uint32_t* bounds, Func&& body, const char* name = "Task")
+	{
+		Dispatch([&body, bounds](uint32_t worker) {
+			for (uint32_t i = bounds[worker]; i < bounds[worker + 1]; i++) {
+				body(i);
+			}
+		}, name);
+	}
+
+	// the molecules per chunk of ParallelFor, rounded up to a multiple of 16
+	// 0 picks about 8 chunks per worker, enough to balance without contending on the counter
+	void SetGrainSize(uint32_t grain);
+	uint32_t GetChunkSize(uint32_t count) const;
+
+	// blocks until every worker of the current dispatch reached the barrier
+	// only valid when called from inside a dispatched task
+	void Barrier();
+
+	uint32_t GetNumThreads() const;
+	// fraction of the wall time the workers spent running tasks since the previous call
+	float SampleUtilisation();
+	// fraction of the worker time inside dispatches spent waiting on the others since the previous call,
+	// at the end of a dispatch or in Barrier, only valid on the thread that dispatches
+	float SampleBarrierIdle();
+
+	// index of the calling thread inside its pool, 0 for any thread outside of one
+	static uint32_t GetWorkerIndex();
+
+private:
+	void WorkerLoop(uint32_t worker);
+	uint64_t RunTask(uint32_t worker);  // returns when the task finished
+
+private:
+	uint32_t m_NumThreads;
+	std::vector<std::thread> m_Threads;
+
+	std::mutex m_Mutex;
+	std::condition_variable m_WakeCondition;
+	std::condition_variable m_DoneCondition;
+	const Task* m_Task = nullptr;
+	const char* m_TaskName = nullptr;
+	uint64_t m_DispatchEnd = 0;  // when the last dispatch returned, the workers trace their wait up to it
+	uint64_t m_Generation = 0;
+	uint32_t m_Pending = 0;
+	bool m_Stop = false;
+
+	// sense-reversing barrier state
+	std::mutex m_BarrierMutex;
+	std::condition_variable m_BarrierCondition;
+	uint32_t m_BarrierCount = 0;
+	uint64_t m_BarrierGeneration = 0;
+
+	uint32_t m_GrainSize = 0;
+	// the next index ParallelFor hands out, on its own cache line as every worker hits it
+	alignas(64) std::atomic<uint32_t> m_NextChunk = 0;
+
+	// utilisation bookkeeping
+	std::vector<std::atomic<uint64_t>> m_BusyNanoseconds;
+	uint64_t m_LastSample;
+
+	// barrier idle bookkeeping, each worker writes its own slots and the dispatching thread sums them
+	std::vector<uint64_t> m_TaskNanoseconds;     // the task of the current dispatch
+	std::vector<uint64_t> m_BarrierNanoseconds;  // waiting in Barrier during the current dispatch
+	uint64_t m_DispatchNanoseconds = 0;          // summed over the workers
+	uint64_t m_IdleNanoseconds = 0;
+
+};
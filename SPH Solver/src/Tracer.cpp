@@ -0,0 +1,135 @@
+#include "Tracer.h"
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+struct TraceEvent
+{
+	const char* Name;
+	uint64_t Start;
+	uint64_t End;
+};
+
+struct TraceRing
+{
+	std::string Name;
+	// never freed, the workers of the solver's static pool still record while the statics are destroyed at exit
+	TraceEvent* Events = nullptr;
+	std::atomic<uint64_t> Written = 0;  // every slice ever recorded, the ring keeps the last EventsPerThread
+	std::atomic<bool> Ready = false;
+};
+
+static struct TracerData
+{
+	std::atomic<bool> Enabled = false;
+	TraceRing Rings[Tracer::MaxThreads];
+} Rdata;
+
+void Tracer::SetEnabled(bool enabled)
+{
+	Rdata.Enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool Tracer::IsEnabled()
+{
+	return Rdata.Enabled.load(std::memory_order_relaxed);
+}
+
+void Tracer::RegisterThread(const std::string& name)
+{
+	const uint32_t slot = ThreadPool::GetWorkerIndex();
+	if (slot >= Tracer::MaxThreads) {
+		std::cout << "Error Tracer::RegisterThread: no ring left for " << name << std::endl;
+		return;
+	}
+	if (!Tracer::IsEnabled()) {
+		return;
+	}
+	// a thread of a new pool takes over the ring of the old thread with the same index
+	TraceRing& ring = Rdata.Rings[slot];
+	ring.Name = name;
+	if (!ring.Ready.load(std::memory_order_acquire)) {
+		ring.Events = new TraceEvent[Tracer::EventsPerThread];
+		ring.Ready.store(true, std::memory_order_release);
+	}
+}
+
+uint64_t Tracer::Now()
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Tracer::Record(const char* name, uint64_t start, uint64_t end)
+{
+	if (!Rdata.Enabled.load(std::memory_order_relaxed)) {
+		return;
+	}
+	const uint32_t slot = ThreadPool::GetWorkerIndex();
+	if (slot >= Tracer::MaxThreads) {
+		return;
+	}
+	TraceRing& ring = Rdata.Rings[slot];
+	if (!ring.Ready.load(std::memory_order_acquire)) {
+		return;
+	}
+	// only this thread writes the ring, the release publishes the slice to Dump
+	const uint64_t written = ring.Written.load(std::memory_order_relaxed);
+	ring.Events[written % Tracer::EventsPerThread] = { name, start, end };
+	ring.Written.store(written + 1, std::memory_order_release);
+}
+
+bool Tracer::Dump(const std::string& path)
+{
+	std::ofstream file(path);
+	if (!file.is_open()) {
+		std::cout << "Error Tracer::Dump: could not open " << path << std::endl;
+		return false;
+	}
+
+	// the timestamps start at the oldest slice still in any ring
+	uint64_t origin = UINT64_MAX;
+	for (const TraceRing& ring : Rdata.Rings) {
+		if (!ring.Ready.load(std::memory_order_acquire)) {
+			continue;
+		}
+		const uint64_t written = ring.Written.load(std::memory_order_acquire);
+		const uint64_t count = std::min<uint64_t>(written, Tracer::EventsPerThread);
+		for (uint64_t e = written - count; e < written; e++) {
+			origin = std::min(origin, ring.Events[e % Tracer::EventsPerThread].Start);
+		}
+	}
+
+	// complete events in microseconds, the thread id is the ring slot
+	file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"SPH Solver\"}}";
+	char line[256];
+	uint64_t slices = 0;
+	for (uint32_t slot = 0; slot < Tracer::MaxThreads; slot++) {
+		const TraceRing& ring = Rdata.Rings[slot];
+		if (!ring.Ready.load(std::memory_order_acquire)) {
+			continue;
+		}
+		file << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << slot << ",\"args\":{\"name\":\"" << ring.Name << "\"}}";
+		file << ",\n{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":1,\"tid\":" << slot << ",\"args\":{\"sort_index\":" << slot << "}}";
+
+		const uint64_t written = ring.Written.load(std::memory_order_acquire);
+		const uint64_t count = std::min<uint64_t>(written, Tracer::EventsPerThread);
+		for (uint64_t e = written - count; e < written; e++) {
+			const TraceEvent& event = ring.Events[e % Tracer::EventsPerThread];
+			std::snprintf(line, sizeof(line), ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+				event.Name, slot, (event.Start - origin) * 1.0e-3, (event.End - event.Start) * 1.0e-3);
+			file << line;
+		}
+		slices += count;
+	}
+	file << "\n]}\n";
+
+	std::cout << "Tracer::Dump: wrote " << slices << " slices to " << path << std::endl;
+	return true;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cinttypes>
+#include <string>
+
+// records timed slices of every thread into its own ring buffer and writes them as a Chrome trace
+// the rings are indexed by the worker index of the thread pool, slot 0 is the thread that runs the main loop
+// every ring has a single writer, so recording takes no lock, only the oldest slices get overwritten
+class Tracer
+{
+public:
+	static constexpr uint32_t MaxThreads = 256;
+	static constexpr uint32_t EventsPerThread = 1 << 16;
+
+public:
+	// the rings are only allocated for threads that register while tracing is enabled
+	static void SetEnabled(bool enabled);
+	static bool IsEnabled();
+	// gives the calling thread its ring, the name is shown in the trace viewer
+	static void RegisterThread(const std::string& name);
+
+	static uint64_t Now();  // in nanoseconds
+	// the name has to outlive the trace, string literals are expected
+	static void Record(const char* name, uint64_t start, uint64_t end);
+
+	// writes every recorded slice to a JSON file for chrome://tracing or ui.perfetto.dev
+	// no traced work may run while the rings are read, call it between two frames
+	static bool Dump(const std::string& path);
+
+private:
+	Tracer() = default;
+
+};
+
+// records the time between its construction and its destruction as one slice of the calling thread
+class TraceScope
+{
+public:
+	TraceScope(const char* name)
+		: m_Name(name), m_Start(Tracer::Now()) {}
+	~TraceScope() { Tracer::Record(m_Name, m_Start, Tracer::Now()); }
+
+	TraceScope(const TraceScope&) = delete;
+	TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+	const char* m_Name;
+	uint64_t m_Start;
+
+};
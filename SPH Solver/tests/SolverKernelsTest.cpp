@@ -0,0 +1,145 @@
+#include "SolverKernels.h"
+
+#include <cmath>
+#include <iostream>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+// compares every kernel variant the processor can run against the scalar reference, the exit code is the number of failures
+
+static constexpr uint32_t Count = 45;
+static constexpr float Radius = 0.35f;
+
+// a range that is not a multiple of the vector width, with pairs on every early exit:
+// outside the radius, on top of each other, equal velocities and too low densities
+static SPHSolver::MoleculeProperties MakeMolecules()
+{
+	SPHSolver::MoleculeProperties props;
+	props.Resize(Count);
+	for (uint32_t k = 0; k < Count; k++) {
+		props.SetPredictedPosition(k, glm::vec3(0.3f * std::sin(1.7f * k), 0.3f * std::cos(2.3f * k), 0.0f));
+		props.SetVelocity(k, glm::vec3(std::sin(0.9f * k), std::cos(0.4f * k), 0.0f));
+		props.Density[k] = k % 11 == 0 ? 0.005f : 10.0f + 3.0f * (k % 7);
+		props.NearDensity[k] = k % 13 == 0 ? 0.005f : 2.0f + (k % 5);
+		props.Pressure[k] = 15.0f * (props.Density[k] - 30.0f);
+		props.NearPressure[k] = 2.0f * props.NearDensity[k];
+	}
+	props.SetPredictedPosition(7, props.GetPredictedPosition(3));
+	props.SetVelocity(8, props.GetVelocity(3));
+	return props;
+}
+
+static uint32_t CheckPairs(const SolverKernels::Variant& variant, const SPHSolver::MoleculeProperties& props)
+{
+	uint32_t failures = 0;
+	const SolverKernels::Constants c = SolverKernels::MakeConstants(Radius, 1.0f, 0.5f);
+	for (uint32_t self = 0; self < Count; self++) {
+		// the reference sums, straight from the kernels of the solver
+		float refDensity = 0.0f;
+		float refNearDensity = 0.0f;
+		glm::vec3 refForce = glm::vec3(0.0f);
+		for (uint32_t j = 0; j < Count; j++) {
+			if (j == self) {
+				continue;
+			}
+			glm::vec3 difference = props.GetPredictedPosition(self) - props.GetPredictedPosition(j);
+			float length = glm::length(difference);
+			refDensity += c.Mass * SPHSolver::Kernel(length, Radius);
+			refNearDensity += c.Mass * SPHSolver::NearDensityKernel(length, Radius);
+
+			if (props.Density[self] < 0.01f || props.Density[j] < 0.01f || props.NearDensity[j] < 0.01f
+				|| length < 0.00001f || length > Radius) {
+				continue;
+			}
+			difference = glm::normalize(difference);
+			refForce += -(props.Pressure[self] + props.Pressure[j]) / (2.0f * props.Density[j]) * SPHSolver::KernelDerivative(length, Radius) * c.Mass * difference;
+			refForce += -(props.NearPressure[self] + props.NearPressure[j]) / (2.0f * props.NearDensity[j]) * SPHSolver::NearDensityKernelDerivative(length, Radius) * c.Mass * difference;
+			glm::vec3 relative = props.GetVelocity(j) - props.GetVelocity(self);
+			if (glm::length(relative) >= 0.00001f) {
+				refForce += c.Viscosity * c.Mass / props.Density[j] * glm::normalize(relative);
+			}
+		}
+
+		float sumDensity = 0.0f;
+		float sumNearDensity = 0.0f;
+		glm::vec3 sumForce = glm::vec3(0.0f);
+		variant.Density(c, props, self, 0, Count, sumDensity, sumNearDensity);
+		variant.Force(c, props, self, 0, Count, sumForce);
+
+		const float tolerance = 1e-4f;
+		const bool match = std::abs(sumDensity - refDensity) <= tolerance * (1.0f + std::abs(refDensity))
+			&& std::abs(sumNearDensity - refNearDensity) <= tolerance * (1.0f + std::abs(refNearDensity))
+			&& glm::length(sumForce - refForce) <= tolerance * (1.0f + glm::length(refForce));
+		if (!match) {
+			std::cout << "Error CheckPairs: the " << variant.Name << " kernels do not match the reference for molecule " << self << std::endl;
+			failures++;
+		}
+	}
+	return failures;
+}
+
+static uint32_t CheckCellKeys(const SolverKernels::Variant& variant, const SPHSolver::MoleculeProperties& props)
+{
+	// the keys have to be exact, or the molecules land in other buckets than the lookups expect
+	uint32_t failures = 0;
+	uint32_t keys[Count];
+	uint32_t refKeys[Count];
+	SolverKernels::CellKeyParams params = { 0.07f, false, glm::ivec3(-5, -4, 0), glm::ivec3(9, 7, 1), 63, Count };
+	for (uint32_t dense = 0; dense < 2; dense++) {
+		params.Dense = dense == 1;
+		SolverKernels::ComputeCellKeysScalar(params, props, 0, Count, refKeys);
+		variant.CellKeys(params, props, 0, Count, keys);
+		for (uint32_t k = 0; k < Count; k++) {
+			if (keys[k] != refKeys[k]) {
+				std::cout << "Error CheckCellKeys: the " << variant.Name << " cell keys do not match the reference for molecule " << k << std::endl;
+				failures++;
+			}
+		}
+	}
+	return failures;
+}
+
+static uint32_t CheckCollisions(const SolverKernels::Variant& variant, SPHSolver::MoleculeProperties props)
+{
+	// a moved, rotated and stretched container, with molecules on both sides of every wall
+	uint32_t failures = 0;
+	CollisionSolver::ContainerState container;
+	container.Transform = glm::translate(glm::mat4(1.0f), glm::vec3(0.1f, -0.2f, 0.0f))
+		* glm::rotate(glm::mat4(1.0f), glm::radians(30.0f), glm::vec3(0.0f, 0.0f, 1.0f))
+		* glm::scale(glm::mat4(1.0f), glm::vec3(0.5f, 0.4f, 1.0f));
+	container.InverseTransform = glm::inverse(container.Transform);
+	container.Rotation = glm::mat3(glm::rotate(glm::mat4(1.0f), glm::radians(30.0f), glm::vec3(0.0f, 0.0f, 1.0f)));
+	container.InverseRotation = glm::transpose(container.Rotation);
+	container.Degenerate = false;
+	for (uint32_t k = 0; k < Count; k++) {
+		props.SetPosition(k, glm::vec3(props.PredictedX[k], props.PredictedY[k], 0.6f * std::sin(0.3f * k)));
+	}
+	SPHSolver::MoleculeProperties reference = props;
+	SolverKernels::ResolveCollisionsScalar(container, reference, 0, Count);
+	variant.Collisions(container, props, 0, Count);
+	for (uint32_t k = 0; k < Count; k++) {
+		const bool match = glm::length(props.GetPosition(k) - reference.GetPosition(k)) <= 1e-4f
+			&& glm::length(props.GetVelocity(k) - reference.GetVelocity(k)) <= 1e-4f;
+		if (!match) {
+			std::cout << "Error CheckCollisions: the " << variant.Name << " collisions do not match the reference for molecule " << k << std::endl;
+			failures++;
+		}
+	}
+	return failures;
+}
+
+int main()
+{
+	const SPHSolver::MoleculeProperties props = MakeMolecules();
+	uint32_t failures = 0;
+	for (const SolverKernels::Variant& variant : SolverKernels::GetVariants()) {
+		if (!SolverKernels::IsSupported(variant.ISA)) {
+			std::cout << variant.Name << ": skipped, the processor does not support it" << std::endl;
+			continue;
+		}
+		const uint32_t variantFailures = CheckPairs(variant, props) + CheckCellKeys(variant, props) + CheckCollisions(variant, props);
+		std::cout << variant.Name << ": " << (variantFailures == 0 ? "matches the reference" : "FAILED") << std::endl;
+		failures += variantFailures;
+	}
+	return failures == 0 ? 0 : 1;
+}